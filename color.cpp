@@ -80,16 +80,38 @@ void ColorSpaceConverter::setRGBColorSpace(const RGBColorSpace &rgbSpace) {
 
     concatMatrix(srgbl2ledl, srgbl2xyz, srgbl2ledl);
 
-    for (size_t c = 0; c < 256; c++) {
-        float v = float(c) * (1.0f / 255.0f);
-        srgb_2_srgbl_lookup_fixed[c] = int32_t((v < 0.04045f) ? (v / 12.92f) : powf((v + 0.055f) / 1.055f, 2.4f) * float(1UL<<fixed_shift));
-    }
-
     for (size_t c = 0; c < 9; c++) {
         srgbl2ledl_fixed[c] = int32_t(srgbl2ledl[c] * float(1UL<<fixed_shift));
         ledl2srgbl_fixed[c] = int32_t(ledl2srgbl[c] * float(1UL<<fixed_shift));
     }
 
+    // LED primaries matching sRGB (the default) leave only rounding noise off
+    // the diagonal, skip the matrix multiply in that case
+    bool diagonal = true;
+    bool identity = true;
+    for (size_t c = 0; c < 9; c++) {
+        int32_t v = srgbl2ledl_fixed[c];
+        if ((c % 4) == 0) {
+            identity &= std::abs(v - int32_t(1UL<<fixed_shift)) < fixed_matrix_epsilon;
+        } else {
+            diagonal &= std::abs(v) < fixed_matrix_epsilon;
+        }
+    }
+    matrix_type = diagonal ? (identity ? MATRIX_IDENTITY : MATRIX_DIAGONAL) : MATRIX_FULL;
+
+    for (size_t c = 0; c < 256; c++) {
+        float v = float(c) * (1.0f / 255.0f);
+        int32_t l = int32_t((v < 0.04045f) ? (v / 12.92f) : powf((v + 0.055f) / 1.055f, 2.4f) * float(1UL<<fixed_shift));
+        if (matrix_type == MATRIX_FULL) {
+            srgb_2_srgbl_lookup_fixed[c] = l;
+            continue;
+        }
+        for (size_t d = 0; d < 3; d++) {
+            int32_t x = (matrix_type == MATRIX_IDENTITY) ? l : mul_fixed(srgbl2ledl_fixed[d * 4], l);
+            channel_lookup[d][c] = uint16_t(std::clamp(x >> (fixed_shift - channel_lookup_shift), int32_t(0), int32_t(1L << channel_lookup_shift)));
+        }
+    }
+
 }
 
 void ColorSpaceConverter::sRGBL2LEDL(float *ledl, const float *srgbl) const {
@@ -239,6 +261,23 @@ rgb::rgb(const hsv &from) {
 	}
 }
 
+rgb8 rgb8::hue(uq16 h) {
+	const uint32_t h6 = h.frac().raw() * 6;
+	const uint32_t f = h6 & (uq16::one_raw - 1);
+	const uint8_t v = 0xFF;
+	const uint8_t t = uint8_t((f * 0xFF) >> uq16::frac_bits);
+	const uint8_t q = uint8_t(((uq16::one_raw - f) * 0xFF) >> uq16::frac_bits);
+	switch (h6 >> uq16::frac_bits) {
+		default:
+		case 0: return rgb8(v, t, 0);
+		case 1: return rgb8(q, v, 0);
+		case 2: return rgb8(0, v, t);
+		case 3: return rgb8(0, q, v);
+		case 4: return rgb8(t, 0, v);
+		case 5: return rgb8(v, 0, q);
+	}
+}
+
 rgb8::rgb8(const rgb &from) {
 	r = sat8(from.r);
 	g = sat8(from.g);
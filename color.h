@@ -27,6 +27,8 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <string.h>
 #include <algorithm>
 
+#include "./fixed.h"
+
 #if __cplusplus < 201703
 #ifndef _LEGACY_CLAMP_
 #define _LEGACY_CLAMP_
@@ -81,7 +83,9 @@ public:
 	static constexpr int32_t fixed_post_shift = 8;
 	static constexpr int32_t fixed_post_clamp = 1UL << (fixed_shift - fixed_post_shift);
 
-    void setRGBColorSpace(const RGBColorSpace &rgbSpace);
+    // Float matrix math, kept out of line so it never ends up in a caller
+    // on the hot path (see float_audit.sh)
+    __attribute__ ((noinline)) void setRGBColorSpace(const RGBColorSpace &rgbSpace);
 
 	inline void sRGB8toLEDPWM(
 			uint8_t srgb_r, 
@@ -92,17 +96,24 @@ public:
 			uint16_t &pwm_g,
 			uint16_t &pwm_b) const {
 #if 1
+		if (matrix_type != MATRIX_FULL) {
+			pwm_r = uint16_t((uint32_t(channel_lookup[0][srgb_r]) * pwm_l) >> channel_lookup_shift);
+			pwm_g = uint16_t((uint32_t(channel_lookup[1][srgb_g]) * pwm_l) >> channel_lookup_shift);
+			pwm_b = uint16_t((uint32_t(channel_lookup[2][srgb_b]) * pwm_l) >> channel_lookup_shift);
+			return;
+		}
+
 		int32_t lr = srgb_2_srgbl_lookup_fixed[srgb_r];
 		int32_t lg = srgb_2_srgbl_lookup_fixed[srgb_g];
 		int32_t lb = srgb_2_srgbl_lookup_fixed[srgb_b];
-	
-		int32_t x = mul_fixed(srgbl2ledl_fixed[0], lr) + mul_fixed(srgbl2ledl_fixed[1], lg) + mul_fixed(srgbl2ledl_fixed[2], lb);
-		int32_t y = mul_fixed(srgbl2ledl_fixed[3], lr) + mul_fixed(srgbl2ledl_fixed[4], lg) + mul_fixed(srgbl2ledl_fixed[5], lb);
-		int32_t z = mul_fixed(srgbl2ledl_fixed[6], lr) + mul_fixed(srgbl2ledl_fixed[7], lg) + mul_fixed(srgbl2ledl_fixed[8], lb);
 
-		pwm_r = uint16_t((std::clamp((x >> fixed_post_shift), int32_t(0), fixed_post_clamp) * pwm_l) / fixed_post_clamp);
-		pwm_g = uint16_t((std::clamp((y >> fixed_post_shift), int32_t(0), fixed_post_clamp) * pwm_l) / fixed_post_clamp);
-		pwm_b = uint16_t((std::clamp((z >> fixed_post_shift), int32_t(0), fixed_post_clamp) * pwm_l) / fixed_post_clamp);
+		int32_t x = dot_fixed(&srgbl2ledl_fixed[0], lr, lg, lb);
+		int32_t y = dot_fixed(&srgbl2ledl_fixed[3], lr, lg, lb);
+		int32_t z = dot_fixed(&srgbl2ledl_fixed[6], lr, lg, lb);
+
+		pwm_r = uint16_t((uint32_t(std::clamp((x >> fixed_post_shift), int32_t(0), fixed_post_clamp)) * pwm_l) >> (fixed_shift - fixed_post_shift));
+		pwm_g = uint16_t((uint32_t(std::clamp((y >> fixed_post_shift), int32_t(0), fixed_post_clamp)) * pwm_l) >> (fixed_shift - fixed_post_shift));
+		pwm_b = uint16_t((uint32_t(std::clamp((z >> fixed_post_shift), int32_t(0), fixed_post_clamp)) * pwm_l) >> (fixed_shift - fixed_post_shift));
 #else            
 		float col[3];
 		col[0] = float(srgb_r) * (1.0f / 255.0f);
@@ -133,10 +144,35 @@ private:
     	return int32_t((int64_t(x) * int64_t(y)) >> fixed_shift);
 	}
 
+	// Accumulates in 64 bits (SMLAL) and shifts once
+	inline int32_t dot_fixed(const int32_t *m, int32_t x, int32_t y, int32_t z) const {
+    	return int32_t((int64_t(m[0]) * int64_t(x) + int64_t(m[1]) * int64_t(y) + int64_t(m[2]) * int64_t(z)) >> fixed_shift);
+	}
+
+	// Coefficients closer than 2^-10 to identity or diagonal are treated as
+	// such, a fraction of an 8-bit step. The sRGB matrix built from the
+	// chromaticities is only off by rounding noise of about 2^-12.
+	static constexpr int32_t fixed_matrix_epsilon = 1L << (fixed_shift - 10);
+
+	enum MatrixType {
+		MATRIX_IDENTITY,
+		MATRIX_DIAGONAL,
+		MATRIX_FULL
+	};
+
+	MatrixType matrix_type = MATRIX_FULL;
+
     float srgbl2ledl[9];
     float ledl2srgbl[9];
     
-    int32_t srgb_2_srgbl_lookup_fixed[256];
+    // Identity and diagonal matrices fold into one table per channel,
+    // holding the LED value already scaled and clamped to 1 << 15. Only the
+    // full matrix needs the linear sRGB values, so both share the space.
+    static constexpr int32_t channel_lookup_shift = 15;
+    union {
+        int32_t srgb_2_srgbl_lookup_fixed[256];
+        uint16_t channel_lookup[3][256];
+    };
     int32_t srgbl2ledl_fixed[9];
     int32_t ledl2srgbl_fixed[9];
 
@@ -215,6 +251,9 @@ public:
     }
 
     explicit rgb8(const rgb &from);
+
+    // Fully saturated color at hue h (in turns), integer only
+    static rgb8 hue(uq16 h);
     
     uint8_t red() const  { return r; }
     uint8_t green() const  { return g; }
@@ -22,18 +22,36 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 #include <stdint.h>
 #include <string.h>
-#include <math.h>
+#include <algorithm>
+
+extern "C" {
+#include "gd32f10x.h"
+}
 
 #include "./main.h"
 #include "./control.h"
 #include "./driver.h"
 #include "./strip.h"
 #include "./spi.h"
+#ifdef PARALLEL_OUTPUT
+#include "./parallel.h"
+#endif  // #ifdef PARALLEL_OUTPUT
 #include "./perf.h"
+#include "./sacn.h"
 #include "./systick.h"
+#include "./status.h"
 
 namespace lightkraken {
 
+#ifdef STRIP_STREAMING
+// A streamed ring is refilled from the interrupts of one DMA only, so the
+// mirror is a second strip fed with the same universes instead.
+static constexpr size_t mirrorStripN = Model::stripN;
+#else  // #ifdef STRIP_STREAMING
+// The mirror output sends the wire buffer of the first strip
+static constexpr size_t mirrorStripN = 1;
+#endif  // #ifdef STRIP_STREAMING
+
 Control &Control::instance() {
     static Control control;
     if (!control.initialized) {
@@ -44,574 +62,291 @@ Control &Control::instance() {
 }
 
 void Control::sync() {
+    size_t strip_first = Model::stripN;
+    size_t strip_end = Model::stripN;
+    size_t terminals = 0;
     switch(Model::instance().outputConfig()) {
-    case Model::OUTPUT_CONFIG_DUAL_STRIP: {
-        for (size_t c = 0; c < lightkraken::Model::stripN; c++) {
-            lightkraken::Strip::get(c).transfer();
-        }
+    case Model::OUTPUT_CONFIG_DUAL_STRIP:
+    case Model::OUTPUT_CONFIG_SPLIT_STRIP: {
+        strip_first = 0;
     } break;
-    case Model::OUTPUT_CONFIG_RGB_DUAL_STRIP: {
-        Driver::instance().sync(0);
-        for (size_t c = 0; c < lightkraken::Model::stripN; c++) {
-            lightkraken::Strip::get(c).transfer();
-        }
+    case Model::OUTPUT_CONFIG_MIRROR_STRIP: {
+        strip_first = 0;
+        strip_end = mirrorStripN;
     } break;
-    case Model::OUTPUT_CONFIG_RGB_STRIP: {
-        Driver::instance().sync(0);
-        for (size_t c = 1; c < lightkraken::Model::stripN; c++) {
-            lightkraken::Strip::get(c).transfer();
-        }
+    case Model::OUTPUT_CONFIG_RGB_DUAL_STRIP: {
+        strip_first = 0;
+        terminals = 1;
     } break;
+    case Model::OUTPUT_CONFIG_RGB_STRIP:
     case Model::OUTPUT_CONFIG_RGBW_STRIP: {
-        Driver::instance().sync(0);
-        for (size_t c = 1; c < lightkraken::Model::stripN; c++) {
-            lightkraken::Strip::get(c).transfer();
-        }
+        strip_first = 1;
+        terminals = 1;
     } break;
     case Model::OUTPUT_CONFIG_RGB_RGB: {
-        for (size_t c = 0; c < Model::analogN; c++) {
-            Driver::instance().sync(c);
-        }
+        terminals = Model::analogN;
     } break;
     case Model::OUTPUT_CONFIG_RGBWWW: {
-        for (size_t c = 0; c < 1; c++) {
-            Driver::instance().sync(c);
-        }
+        terminals = 1;
     } break;
     default: {
     } break;
     }
+    startOutputs(strip_first, strip_end, terminals);
 }
 
-void Control::collectAllActiveArtnetUniverses(std::array<uint16_t, Model::maxUniverses> &universes, size_t &universeCount) {
-    universeCount = 0;
-    class UniqueCollector {
-    public:
-        UniqueCollector() {
-            memset(&collected_universes[0], 0xFF, sizeof(collected_universes));
-        }
-    
-        void maybeAcquire(uint16_t universe) {
-            for (size_t c = 0; c < Model::maxUniverses; c++) {
-                if (collected_universes[c] == universe) {
-                    return;
-                }
-                if (collected_universes[c] == 0xFFFF) {
-                    collected_universes[c] = universe;
-                    return;
-                }
-            }
+// Two phases so that all outputs start together: everything which takes
+// time (wire encoding, PWM conversion) happens first, then the SPI DMAs are
+// started and the PWM timers latched back to back with interrupts off. The
+// time between the first and the last start is kept as the sync skew.
+void Control::startOutputs(size_t strip_first, size_t strip_end, size_t terminals) {
+    size_t prepared = 0;
+    for (size_t c = strip_first; c < strip_end; c++) {
+        if (Strip::get(c).prepareTransfer(false)) {
+            prepared++;
         }
+    }
+    for (size_t c = 0; c < terminals; c++) {
+        Driver::instance().prepare(c);
+    }
 
-        void fillArray(std::array<uint16_t, Model::maxUniverses> &universes, size_t &universeCount) {
-            for (size_t c = 0; c < Model::maxUniverses; c++) {
-                if (collected_universes[c] == 0xFFFF) {
-                    return;
-                }
-                universes[universeCount++] = collected_universes[c];
-            }
-        }
-    private:
-        uint16_t collected_universes[Model::maxUniverses];
-    } uniqueCollector;
+    __disable_irq();
+    uint64_t first = Systick::instance().systemTick();
+    for (size_t c = strip_first; c < strip_end; c++) {
+        Strip::get(c).commitTransfer();
+    }
+    Driver::instance().latch();
+    uint64_t last = Systick::instance().systemTick();
+    __enable_irq();
+
+    // A single output has nothing to be skewed against
+    if (prepared + (terminals ? 1 : 0) > 1) {
+        sync_skew = uint32_t(last - first);
+        sync_skew_max = std::max(sync_skew_max, sync_skew);
+    }
+}
 
+// Compiles the configured universes of the current output config into
+// per protocol tables sorted by universe. The packet path then only has to
+// find the routes for a universe and never touches the model. Tables are
+// double buffered since Model::apply runs from the SysTick interrupt, a
+// packet being routed keeps using the table it started with.
+void Control::updateRoutes() {
+    Routes &next = routes[(active_routes == &routes[0]) ? 1 : 0];
+
+    size_t strip_first = Model::stripN;
+    size_t strip_end = Model::stripN;
+    size_t terminals = 0;
+    size_t components = 0;
     switch(Model::instance().outputConfig()) {
-    case Model::OUTPUT_CONFIG_DUAL_STRIP: {
-        for (size_t c = 0; c < lightkraken::Model::stripN; c++) {
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Strip::get(c).isUniverseActive(d, Strip::InputType(Model::instance().stripConfig(c).input_type))) {
-                    uniqueCollector.maybeAcquire(Model::instance().artnetStrip(c,d));
-                }
-            }
-        }
+    case Model::OUTPUT_CONFIG_DUAL_STRIP:
+    case Model::OUTPUT_CONFIG_SPLIT_STRIP: {
+        strip_first = 0;
+    } break;
+    case Model::OUTPUT_CONFIG_MIRROR_STRIP: {
+        strip_first = 0;
+        strip_end = mirrorStripN;
     } break;
     case Model::OUTPUT_CONFIG_RGB_DUAL_STRIP: {
-        for (size_t c = 0; c < 3; c++) { 
-            uniqueCollector.maybeAcquire(Model::instance().analogConfig(0).components[c].artnet.universe);
-        }
-        for (size_t c = 0; c < lightkraken::Model::stripN; c++) {
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Strip::get(c).isUniverseActive(d, Strip::InputType(Model::instance().stripConfig(c).input_type))) {
-                    uniqueCollector.maybeAcquire(Model::instance().artnetStrip(c, d));
-                }
-            }
-        }
+        strip_first = 0;
+        terminals = 1;
+        components = 3;
     } break;
     case Model::OUTPUT_CONFIG_RGB_STRIP: {
-        for (size_t c = 0; c < 3; c++) { 
-            uniqueCollector.maybeAcquire(Model::instance().analogConfig(0).components[c].artnet.universe);
-        }
-        for (size_t c = 1; c < lightkraken::Model::stripN; c++) {
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Strip::get(c).isUniverseActive(d, Strip::InputType(Model::instance().stripConfig(c).input_type))) {
-                    uniqueCollector.maybeAcquire(Model::instance().artnetStrip(c, d));
-                }
-            }
-        }
+        strip_first = 1;
+        terminals = 1;
+        components = 3;
     } break;
     case Model::OUTPUT_CONFIG_RGBW_STRIP: {
-        for (size_t c = 0; c < 4; c++) { 
-            uniqueCollector.maybeAcquire(Model::instance().analogConfig(0).components[c].artnet.universe);
-        }
-        for (size_t c = 1; c < lightkraken::Model::stripN; c++) {
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Strip::get(c).isUniverseActive(d, Strip::InputType(Model::instance().stripConfig(c).input_type))) {
-                    uniqueCollector.maybeAcquire(Model::instance().artnetStrip(c, d));
-                }
-            }
-        }
+        strip_first = 1;
+        terminals = 1;
+        components = 4;
     } break;
     case Model::OUTPUT_CONFIG_RGB_RGB: {
-        for (size_t c = 0; c < Model::analogN; c++) {
-            for (size_t d = 0; d < 3; d++) { 
-                uniqueCollector.maybeAcquire(Model::instance().analogConfig(c).components[d].artnet.universe);
-            }
-        }
+        terminals = Model::analogN;
+        components = 3;
     } break;
     case Model::OUTPUT_CONFIG_RGBWWW: {
-        for (size_t c = 0; c < 1; c++) {
-            for (size_t d = 0; d < 5; d++) { 
-                uniqueCollector.maybeAcquire(Model::instance().analogConfig(c).components[d].artnet.universe);
-            }
-        }
+        terminals = 1;
+        components = 5;
     } break;
     default: {
     } break;
     }
-    uniqueCollector.fillArray(universes, universeCount);
-}
 
-void Control::collectAllActiveE131Universes(std::array<uint16_t, Model::maxUniverses> &universes, size_t &universeCount) {
-    universeCount = 0;
-    class UniqueCollector {
-    public:
-        UniqueCollector() {
-            memset(&collected_universes[0], 0xFF, sizeof(collected_universes));
+    next.artnet.count = 0;
+    next.e131.count = 0;
+    next.split_strip = Model::instance().splitStrip();
+
+    auto add = [] (RouteTable &table, const Route &route) {
+        if (table.count < table.routes.size()) {
+            table.routes[table.count++] = route;
         }
-    
-        void maybeAcquire(uint16_t universe) {
-            for (size_t c = 0; c < Model::maxUniverses; c++) {
-                if (collected_universes[c] == universe) {
-                    return;
-                }
-                if (collected_universes[c] == 0xFFFF) {
-                    collected_universes[c] = universe;
-                    return;
-                }
-            }
+    };
+
+    for (size_t c = 0; c < terminals; c++) {
+        for (size_t d = 0; d < components; d++) {
+            const Model::AnalogConfig::Component &component = Model::instance().analogConfig(c).components[d];
+            add(next.artnet, { component.artnet.universe, uint16_t(std::clamp(component.artnet.channel - 1, 0, 511)), uint8_t(c), uint8_t(d), 0, true });
+            add(next.e131, { component.e131.universe, uint16_t(std::clamp(component.e131.channel - 1, 0, 511)), uint8_t(c), uint8_t(d), 0, true });
         }
+    }
 
-        void fillArray(std::array<uint16_t, Model::maxUniverses> &universes, size_t &universeCount) {
-            for (size_t c = 0; c < Model::maxUniverses; c++) {
-                if (collected_universes[c] == 0xFFFF) {
-                    return;
-                }
-                universes[universeCount++] = collected_universes[c];
+    // A split strip takes its universes from both strip configs in a row,
+    // the second output continues after the universes of the first one.
+    // A mirrored strip only has the universes of the first strip config.
+    const bool mirror = Model::instance().outputConfig() == Model::OUTPUT_CONFIG_MIRROR_STRIP;
+    const size_t split = Model::instance().splitStrip() ? Model::instance().splitUniverses() : 0;
+    for (size_t c = strip_first; c < strip_end; c++) {
+        const Strip::InputType input_type = Strip::InputType(Model::instance().outputStripConfig(c).input_type);
+        for (size_t d = 0; d < Model::universeN; d++) {
+            if (Strip::get(c).isUniverseActive(d, input_type)) {
+                const size_t index = split ? c * split + d : (mirror ? d : c * Model::universeN + d);
+                const int32_t strip = int32_t(index / Model::universeN);
+                const int32_t slot = int32_t(index % Model::universeN);
+                add(next.artnet, { Model::instance().artnetStrip(strip, slot), 0, uint8_t(c), uint8_t(d), uint8_t(input_type), false });
+                add(next.e131, { Model::instance().e131Strip(strip, slot), 0, uint8_t(c), uint8_t(d), uint8_t(input_type), false });
             }
         }
-    private:
-        uint16_t collected_universes[Model::maxUniverses];
-    } uniqueCollector;
+    }
 
-    switch (Model::instance().outputConfig()) {
-    case Model::OUTPUT_CONFIG_DUAL_STRIP: {
-            for (size_t c = 0; c < lightkraken::Model::stripN; c++) {
-                for (size_t d = 0; d < Model::universeN; d++) {
-                    if (Strip::get(c).isUniverseActive(d, Strip::InputType(Model::instance().stripConfig(c).input_type))) {
-                        uniqueCollector.maybeAcquire(Model::instance().e131Strip(c, d));
-                    }
-                }
-            }
-        } break;
-    case Model::OUTPUT_CONFIG_RGB_DUAL_STRIP: {
-            for (size_t c = 0; c < 3; c++) { 
-                uniqueCollector.maybeAcquire(Model::instance().analogConfig(0).components[c].e131.universe);
-            }
-            for (size_t c = 0; c < lightkraken::Model::stripN; c++) {
-                for (size_t d = 0; d < Model::universeN; d++) {
-                    if (Strip::get(c).isUniverseActive(d, Strip::InputType(Model::instance().stripConfig(c).input_type))) {
-                        uniqueCollector.maybeAcquire(Model::instance().e131Strip(c, d));
-                    }
-                }
-            }
-        } break;
-    case Model::OUTPUT_CONFIG_RGB_STRIP: {
-            for (size_t c = 0; c < 3; c++) { 
-                uniqueCollector.maybeAcquire(Model::instance().analogConfig(0).components[c].e131.universe);
-            }
-            for (size_t c = 1; c < lightkraken::Model::stripN; c++) {
-                for (size_t d = 0; d < Model::universeN; d++) {
-                    if (Strip::get(c).isUniverseActive(d, Strip::InputType(Model::instance().stripConfig(c).input_type))) {
-                        uniqueCollector.maybeAcquire(Model::instance().e131Strip(c, d));
-                    }
-                }
-            }
-        } break;
-    case Model::OUTPUT_CONFIG_RGBW_STRIP: {
-            for (size_t c = 0; c < 4; c++) { 
-                uniqueCollector.maybeAcquire(Model::instance().analogConfig(0).components[c].e131.universe);
-            }
-            for (size_t c = 1; c < lightkraken::Model::stripN; c++) {
-                for (size_t d = 0; d < Model::universeN; d++) {
-                    if (Strip::get(c).isUniverseActive(d, Strip::InputType(Model::instance().stripConfig(c).input_type))) {
-                        uniqueCollector.maybeAcquire(Model::instance().e131Strip(c, d));
-                    }
-                }
-            }
-        } break;
-    case Model::OUTPUT_CONFIG_RGB_RGB: {
-            for (size_t c = 0; c < Model::analogN; c++) {
-                for (size_t d = 0; d < 3; d++) { 
-                    uniqueCollector.maybeAcquire(Model::instance().analogConfig(c).components[d].e131.universe);
-                }
-            }
-        } break;
-    case Model::OUTPUT_CONFIG_RGBWWW: {
-            for (size_t c = 0; c < 1; c++) {
-                for (size_t d = 0; d < 5; d++) { 
-                    uniqueCollector.maybeAcquire(Model::instance().analogConfig(c).components[d].e131.universe);
-                }
-            }
-        } break;
-    default: {
-        } break;
+    // Keep terminals ahead of strips within a universe, like before
+    auto order = [] (const Route &a, const Route &b) {
+        if (a.universe != b.universe) {
+            return a.universe < b.universe;
+        }
+        if (a.terminal != b.terminal) {
+            return a.terminal;
+        }
+        if (a.target != b.target) {
+            return a.target < b.target;
+        }
+        return a.slot < b.slot;
+    };
+    std::sort(next.artnet.routes.begin(), next.artnet.routes.begin() + next.artnet.count, order);
+    std::sort(next.e131.routes.begin(), next.e131.routes.begin() + next.e131.count, order);
+
+    const bool mirrored = Strip::get(0).setMirrorSPI((mirror && mirrorStripN == 1) ? &SPI_2::instance() : 0);
+    if (mirror && mirrorStripN == 1 && !mirrored) {
+        DEBUG_PRINTF(("Mirror output can't match the bit rate of the strip, not sent.\n"));
     }
-    uniqueCollector.fillArray(universes, universeCount);
-}
 
-void Control::interateAllActiveArtnetUniverses(std::function<void (uint16_t universe)> callback) {
-    size_t universeCount = 0;
-    std::array<uint16_t, Model::maxUniverses> universes;
-    collectAllActiveArtnetUniverses(universes, universeCount);
+    // Physical strips behind each strip, for the power estimate
+    for (size_t c = 0; c < Model::stripN; c++) {
+        const bool driven = c >= strip_first && c < strip_end;
+        Strip::get(c).setPowerOutputs(driven ? (mirrored ? 2 : 1) : 0);
+    }
+
+    active_routes = &next;
+
+    // The multicast groups follow the new routes, from the main loop
+    join_scheduled = true;
+}
 
-    for (size_t c = 0; c < universeCount; c++) {
-        callback(universes[c]);
+void Control::collectUniverses(const RouteTable &table, std::array<uint16_t, Model::maxUniverses> &universes, size_t &universeCount) {
+    universeCount = 0;
+    for (size_t c = 0; c < table.count; c++) {
+        if (universeCount == 0 || universes[universeCount - 1] != table.routes[c].universe) {
+            universes[universeCount++] = table.routes[c].universe;
+        }
     }
 }
 
-void Control::setArtnetUniverseOutputDataForDriver(size_t terminals, size_t components, uint16_t uni, const uint8_t *data, size_t len) {
+void Control::collectAllActiveArtnetUniverses(std::array<uint16_t, Model::maxUniverses> &universes, size_t &universeCount) {
+    collectUniverses(active_routes->artnet, universes, universeCount);
+}
+
+void Control::collectAllActiveE131Universes(std::array<uint16_t, Model::maxUniverses> &universes, size_t &universeCount) {
+    collectUniverses(active_routes->e131, universes, universeCount);
+}
+
+void Control::setUniverseOutputData(const Routes &current, const RouteTable &table, uint16_t uni, const uint8_t *data, size_t len, bool nodriver) {
     clearStartup();
 
+    PerfMeasure perf(PerfMeasure::SLOT_SET_DATA);
+
+    const Route *end = table.routes.data() + table.count;
+    const Route *route = std::lower_bound(table.routes.data(), end, uni, [] (const Route &r, uint16_t u) {
+        return r.universe < u;
+    });
+
+    uint32_t strips = 0;
+    uint32_t terminals = 0;
     rgbww rgb[Driver::terminalN];
-    for (size_t c = 0; c < terminals; c++) {
-        rgb[c] = Driver::instance().srgbwwCIE(c);
+    for (; route != end && route->universe == uni; route++) {
+        const size_t target = route->target;
+        if (route->terminal) {
+            if (nodriver) {
+                continue;
+            }
+            if (!(terminals & (1UL << target))) {
+                terminals |= 1UL << target;
+                rgb[target] = Driver::instance().srgbwwCIE(target);
+            }
+            if (len > route->channel) {
+                const uint16_t value = data[route->channel];
+                switch(route->slot) {
+                case 0: rgb[target].r = value; break;
+                case 1: rgb[target].g = value; break;
+                case 2: rgb[target].b = value; break;
+                case 3: rgb[target].w = value; break;
+                case 4: rgb[target].ww = value; break;
+                }
+            }
+        } else {
+            Strip &strip = Strip::get(target);
+            if (!syncMode) {
+                strip.frameUniverse(route->slot);
+            }
+            strip.setUniverseData(route->slot, data, len, Strip::InputType(route->input_type));
+            strips |= 1UL << target;
+        }
     }
-    for (size_t c = 0; c < terminals; c++) {
-        switch(components) {
-        case 5: {
-            size_t channel = size_t(std::clamp(Model::instance().analogConfig(c).components[4].artnet.channel - 1, 0, 511));
-            if (len > channel) {
-                if (Model::instance().analogConfig(c).components[4].artnet.universe == uni) {
-                    rgb[c].ww = data[channel];
-                }
-            }
-        } 
-        [[fallthrough]];
-        case 4: {
-            size_t channel = size_t(std::clamp(Model::instance().analogConfig(c).components[3].artnet.channel - 1, 0, 511));
-            if (len > channel) {
-                if (Model::instance().analogConfig(c).components[3].artnet.universe == uni) {
-                    rgb[c].w = data[channel];
-                }
-            }
-        } 
-        [[fallthrough]];
-        case 3: {
-            size_t channel = size_t(std::clamp(Model::instance().analogConfig(c).components[2].artnet.channel - 1, 0, 511));
-            if (len > channel) {
-                if (Model::instance().analogConfig(c).components[2].artnet.universe == uni) {
-                    rgb[c].b = data[channel];
-                }
-            }
-        } 
-        [[fallthrough]];
-        case 2: {
-            size_t channel = size_t(std::clamp(Model::instance().analogConfig(c).components[1].artnet.channel - 1, 0, 511));
-            if (len > channel) {
-                if (Model::instance().analogConfig(c).components[1].artnet.universe == uni) {
-                    rgb[c].g = data[channel];
-                }
-            }
-        } 
-        [[fallthrough]];
-        case 1: {
-            size_t channel = size_t(std::clamp(Model::instance().analogConfig(c).components[0].artnet.channel - 1, 0, 511));
-            if (len > channel) {
-                if (Model::instance().analogConfig(c).components[0].artnet.universe == uni) {
-                    rgb[c].r = data[channel];
-                }
+
+    for (size_t c = 0; c < Driver::terminalN; c++) {
+        if (terminals & (1UL << c)) {
+            Driver::instance().setRGBWW(c, rgb[c]);
+            if (!syncMode) {
+                Driver::instance().sync(c);
             }
-        } 
-        [[fallthrough]];
-        default:
-        case 0:
-        break;
         }
     }
-    for (size_t c = 0; c < terminals; c++) {
-        Driver::instance().setRGBWW(c,rgb[c]);
-        if (!syncMode) {
-            Driver::instance().sync(c);
+
+    if (strips && current.split_strip) {
+        setDataReceived();
+        if (!syncMode && Strip::get(0).frameComplete() && Strip::get(1).frameComplete()) {
+            transferSplitFrame();
         }
+        return;
     }
-}
 
-void Control::setE131UniverseOutputDataForDriver(size_t terminals, size_t components, uint16_t uni, const uint8_t *data, size_t len) {
-    clearStartup();
-
-    rgbww rgb[Driver::terminalN];
-    for (size_t c = 0; c < terminals; c++) {
-        rgb[c] = Driver::instance().srgbwwCIE(c);
-    }
-    for (size_t c = 0; c < terminals; c++) {
-        switch(components) {
-        case 5: {
-            size_t channel = size_t(std::clamp(Model::instance().analogConfig(c).components[4].e131.channel - 1, 0, 511));
-            if (len > channel) {
-                if (Model::instance().analogConfig(c).components[4].e131.universe == uni) {
-                    rgb[c].ww = data[channel];
-                }
-            }
-        } 
-        [[fallthrough]];
-        case 4: {
-            size_t channel = size_t(std::clamp(Model::instance().analogConfig(c).components[3].e131.channel - 1, 0, 511));
-            if (len > channel) {
-                if (Model::instance().analogConfig(c).components[3].e131.universe == uni) {
-                    rgb[c].w = data[channel];
-                }
-            }
-        } 
-        [[fallthrough]];
-        case 3: {
-            size_t channel = size_t(std::clamp(Model::instance().analogConfig(c).components[2].e131.channel - 1, 0, 511));
-            if (len > channel) {
-                if (Model::instance().analogConfig(c).components[2].e131.universe == uni) {
-                    rgb[c].b = data[channel];
-                }
-            }
-        } 
-        [[fallthrough]];
-        case 2: {
-            size_t channel = size_t(std::clamp(Model::instance().analogConfig(c).components[1].e131.channel - 1, 0, 511));
-            if (len > channel) {
-                if (Model::instance().analogConfig(c).components[1].e131.universe == uni) {
-                    rgb[c].g = data[channel];
-                }
-            }
-        } 
-        [[fallthrough]];
-        case 1: {
-            size_t channel = size_t(std::clamp(Model::instance().analogConfig(c).components[0].e131.channel - 1, 0, 511));
-            if (len > channel) {
-                if (Model::instance().analogConfig(c).components[0].e131.universe == uni) {
-                    rgb[c].r = data[channel];
-                }
+    for (size_t c = 0; c < Model::stripN; c++) {
+        if (strips & (1UL << c)) {
+            setDataReceived();
+            if (!syncMode && Strip::get(c).frameComplete()) {
+                Strip::get(c).transferFrame();
             }
-        } 
-        [[fallthrough]];
-        default:
-        case 0:
-        break;
-        }
-    }
-    for (size_t c = 0; c < terminals; c++) {
-        Driver::instance().setRGBWW(c,rgb[c]);
-        if (!syncMode) {
-            Driver::instance().sync(c);
         }
     }
 }
 
+// Both halves of a split strip go out together
+void Control::transferSplitFrame() {
+    for (size_t c = 0; c < Model::stripN; c++) {
+        Strip::get(c).clearFrame();
+    }
+    startOutputs(0, Model::stripN, 0);
+}
 
 void Control::setArtnetUniverseOutputData(uint16_t uni, const uint8_t *data, size_t len, bool nodriver) {
-    clearStartup();
-
-    PerfMeasure perf(PerfMeasure::SLOT_SET_DATA);
-    switch(Model::instance().outputConfig()) {
-    case Model::OUTPUT_CONFIG_DUAL_STRIP: {
-        for (size_t c = 0; c < Model::stripN; c++) {
-            bool set = false;
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Model::instance().artnetStrip(c,d) == uni) {
-                    lightkraken::Strip::get(c).setUniverseData(d, data, len, Strip::InputType(Model::instance().stripConfig(c).input_type));
-                    set = true;
-                }
-            }
-            if (set) {
-                setDataReceived();
-            }
-            if (set && !syncMode) {
-                lightkraken::Strip::get(c).transfer();
-            }
-        }
-    } break;
-    case Model::OUTPUT_CONFIG_RGB_DUAL_STRIP: {
-        if (!nodriver) {
-            setArtnetUniverseOutputDataForDriver(1, 3, uni, data, len);
-        }
-        for (size_t c = 0; c < Model::stripN; c++) {
-            bool set = false;
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Model::instance().artnetStrip(c, d) == uni) {
-                    lightkraken::Strip::get(c).setUniverseData(d, data, len, Strip::InputType(Model::instance().stripConfig(c).input_type));
-                    set = true;
-                }
-            }
-            if (set) {
-                setDataReceived();
-            }
-            if (set && !syncMode) {
-                lightkraken::Strip::get(c).transfer();
-            }
-        }
-    } break;
-    case Model::OUTPUT_CONFIG_RGB_STRIP: {
-        if (!nodriver) {
-            setArtnetUniverseOutputDataForDriver(1, 3, uni, data, len);
-        }
-        for (size_t c = 1; c < Model::stripN; c++) {
-            bool set = false;
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Model::instance().artnetStrip(c, d) == uni) {
-                    lightkraken::Strip::get(c).setUniverseData(d, data, len, Strip::InputType(Model::instance().stripConfig(c).input_type));
-                    set = true;
-                }
-            }
-            if (set) {
-                setDataReceived();
-            }
-            if (set && !syncMode) {
-                lightkraken::Strip::get(c).transfer();
-            }
-        }
-    } break;
-    case Model::OUTPUT_CONFIG_RGBW_STRIP: {
-        if (!nodriver) {
-            setArtnetUniverseOutputDataForDriver(1, 4, uni, data, len);
-        }
-        for (size_t c = 1; c < Model::stripN; c++) {
-            bool set = false;
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Model::instance().artnetStrip(c, d) == uni) {
-                    lightkraken::Strip::get(c).setUniverseData(d, data, len, Strip::InputType(Model::instance().stripConfig(c).input_type));
-                    set = true;
-                }
-            }
-            if (set) {
-                setDataReceived();
-            }
-            if (set && !syncMode) {
-                lightkraken::Strip::get(c).transfer();
-            }
-        }
-    } break;
-    case Model::OUTPUT_CONFIG_RGB_RGB: {
-        if (!nodriver) {
-            setArtnetUniverseOutputDataForDriver(Model::analogN, 3, uni, data, len);
-        }
-    } break;
-    case Model::OUTPUT_CONFIG_RGBWWW: {
-        if (!nodriver) {
-            setArtnetUniverseOutputDataForDriver(Model::analogN, 5, uni, data, len);
-        }
-    } break;
-    }
+    // One table for the whole packet, even if apply swaps it meanwhile
+    const Routes *current = active_routes;
+    setUniverseOutputData(*current, current->artnet, uni, data, len, nodriver);
 }
 
 void Control::setE131UniverseOutputData(uint16_t uni, const uint8_t *data, size_t len, bool nodriver) {
-    clearStartup();
-
-    PerfMeasure perf(PerfMeasure::SLOT_SET_DATA);
-    switch(Model::instance().outputConfig()) {
-    case Model::OUTPUT_CONFIG_DUAL_STRIP: {
-        for (size_t c = 0; c < Model::stripN; c++) {
-            bool set = false;
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Model::instance().e131Strip(c,d) == uni) {
-                    lightkraken::Strip::get(c).setUniverseData(d, data, len, Strip::InputType(Model::instance().stripConfig(c).input_type));
-                    set = true;
-                }
-            }
-            if (set) {
-                setDataReceived();
-            }
-            if (set && !syncMode) {
-                lightkraken::Strip::get(c).transfer();
-            }
-        }
-    } break;
-    case Model::OUTPUT_CONFIG_RGB_DUAL_STRIP: {
-        if (!nodriver) {
-            setE131UniverseOutputDataForDriver(1, 3, uni, data, len);
-        }
-        for (size_t c = 0; c < Model::stripN; c++) {
-            bool set = false;
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Model::instance().e131Strip(c, d) == uni) {
-                    lightkraken::Strip::get(c).setUniverseData(d, data, len, Strip::InputType(Model::instance().stripConfig(c).input_type));
-                    set = true;
-                }
-            }
-            if (set) {
-                setDataReceived();
-            }
-            if (set && !syncMode) {
-                lightkraken::Strip::get(c).transfer();
-            }
-        }
-    } break;
-    case Model::OUTPUT_CONFIG_RGB_STRIP: {
-        if (!nodriver) {
-            setE131UniverseOutputDataForDriver(1, 3, uni, data, len);
-        }
-        for (size_t c = 1; c < Model::stripN; c++) {
-            bool set = false;
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Model::instance().e131Strip(c, d) == uni) {
-                    lightkraken::Strip::get(c).setUniverseData(d, data, len, Strip::InputType(Model::instance().stripConfig(c).input_type));
-                    set = true;
-                }
-            }
-            if (set) {
-                setDataReceived();
-            }
-            if (set && !syncMode) {
-                lightkraken::Strip::get(c).transfer();
-            }
-        }
-    } break;
-    case Model::OUTPUT_CONFIG_RGBW_STRIP: {
-        if (!nodriver) {
-            setE131UniverseOutputDataForDriver(1, 4, uni, data, len);
-        }
-        for (size_t c = 1; c < Model::stripN; c++) {
-            bool set = false;
-            for (size_t d = 0; d < Model::universeN; d++) {
-                if (Model::instance().e131Strip(c, d) == uni) {
-                    lightkraken::Strip::get(c).setUniverseData(d, data, len, Strip::InputType(Model::instance().stripConfig(c).input_type));
-                    set = true;
-                }
-            }
-            if (set) {
-                setDataReceived();
-            }
-            if (set && !syncMode) {
-                lightkraken::Strip::get(c).transfer();
-            }
-        }
-    } break;
-    case Model::OUTPUT_CONFIG_RGB_RGB: {
-        if (!nodriver) {
-            setE131UniverseOutputDataForDriver(Model::analogN, 3, uni, data, len);
-        }
-    } break;
-    case Model::OUTPUT_CONFIG_RGBWWW: {
-        if (!nodriver) {
-            setE131UniverseOutputDataForDriver(Model::analogN, 5, uni, data, len);
-        }
-    } break;
-    }
+    const Routes *current = active_routes;
+    setUniverseOutputData(*current, current->e131, uni, data, len, nodriver);
 }
 
 void Control::setColor() {
@@ -622,19 +357,19 @@ void Control::setColor() {
         switch(cpp) {
             case 3: {
                 for (size_t d = 0; d <= sizeof(buf)-3; d += 3) {
-                    buf[d + 0] = (Model::instance().stripConfig(c).color.r) & 0xFF;
-                    buf[d + 1] = (Model::instance().stripConfig(c).color.g) & 0xFF;
-                    buf[d + 2] = (Model::instance().stripConfig(c).color.b) & 0xFF;
+                    buf[d + 0] = (Model::instance().outputStripConfig(c).color.r) & 0xFF;
+                    buf[d + 1] = (Model::instance().outputStripConfig(c).color.g) & 0xFF;
+                    buf[d + 2] = (Model::instance().outputStripConfig(c).color.b) & 0xFF;
                     len += 3;
                 }
 				lightkraken::Strip::get(c).setData(buf, len, Strip::INPUT_dRGB8);
             } break;
             case 4: {
                 for (size_t d = 0; d <= sizeof(buf)-4; d += 4) {
-                    buf[d + 0] = (Model::instance().stripConfig(c).color.r) & 0xFF;
-                    buf[d + 1] = (Model::instance().stripConfig(c).color.g) & 0xFF;
-                    buf[d + 2] = (Model::instance().stripConfig(c).color.b) & 0xFF;
-                    buf[d + 3] = (Model::instance().stripConfig(c).color.x) & 0xFF;
+                    buf[d + 0] = (Model::instance().outputStripConfig(c).color.r) & 0xFF;
+                    buf[d + 1] = (Model::instance().outputStripConfig(c).color.g) & 0xFF;
+                    buf[d + 2] = (Model::instance().outputStripConfig(c).color.b) & 0xFF;
+                    buf[d + 3] = (Model::instance().outputStripConfig(c).color.x) & 0xFF;
                     len += 4;
                 }
 				lightkraken::Strip::get(c).setData(buf, len, Strip::INPUT_dRGBW8);
@@ -642,11 +377,11 @@ void Control::setColor() {
             case 6: {
                 for (size_t d = 0; d <= sizeof(buf)-6; d += 6) {
                     buf[d + 0] = 
-                    buf[d + 1] = (Model::instance().stripConfig(c).color.r) & 0xFF;
+                    buf[d + 1] = (Model::instance().outputStripConfig(c).color.r) & 0xFF;
                     buf[d + 2] = 
-                    buf[d + 3] = (Model::instance().stripConfig(c).color.g) & 0xFF;
+                    buf[d + 3] = (Model::instance().outputStripConfig(c).color.g) & 0xFF;
                     buf[d + 4] = 
-                    buf[d + 5] = (Model::instance().stripConfig(c).color.b) & 0xFF;
+                    buf[d + 5] = (Model::instance().outputStripConfig(c).color.b) & 0xFF;
                     len += 6;
                 }
 				lightkraken::Strip::get(c).setData(buf, len, Strip::INPUT_dRGB16MSB);
@@ -655,7 +390,29 @@ void Control::setColor() {
     }
 }
 
+// What is left for the strips of the power the PSE granted, in mW. Zero
+// leaves them unlimited, as does a supply which isn't PoE.
+uint32_t Control::powerBudget() const {
+    if (!Model::instance().powerLimit()) {
+        return 0;
+    }
+    const uint32_t granted = StatusLED::instance().classPower();
+    if (granted <= boardPower) {
+        return 0;
+    }
+    return (granted - boardPower) * converterEfficiency / 100;
+}
+
 void Control::update() {
+    Strip::setPowerBudget(powerBudget());
+
+    // Routes are compiled by Model::apply from the SysTick interrupt, IGMP
+    // can only be used from here
+    if (join_scheduled) {
+        join_scheduled = false;
+        sACNPacket::joinNetworks();
+    }
+
 	if (inStartup()) {
 		startupModePattern();
 		sync();
@@ -687,16 +444,45 @@ void Control::update() {
         } break;
         case Model::OUTPUT_CONFIG_RGBWWW: {
         } break;
+        case Model::OUTPUT_CONFIG_SPLIT_STRIP: {
+            startOutputs(0, Model::stripN, 0);
+        } break;
+        case Model::OUTPUT_CONFIG_MIRROR_STRIP: {
+            for (size_t c = 0; c < mirrorStripN; c++) {
+                lightkraken::Strip::get(c).transfer();
+            }
+        } break;
         default: {
         } break;
         }
     }
 
-    lightkraken::SPI_0::instance().setFast(lightkraken::Strip::get(0).needsClock() == false);
-    lightkraken::SPI_2::instance().setFast(lightkraken::Strip::get(1).needsClock() == false);
-    
+    // Frames which are still missing universes after the frame timeout
+    if (!syncMode && Model::instance().splitStrip()) {
+        if (lightkraken::Strip::get(0).frameTimedOut() || lightkraken::Strip::get(1).frameTimedOut()) {
+            transferSplitFrame();
+        }
+    } else if (!syncMode) {
+        for (size_t c = 0; c < lightkraken::Model::stripN; c++) {
+            if (lightkraken::Strip::get(c).frameTimedOut()) {
+                lightkraken::Strip::get(c).transferFrame();
+            }
+        }
+    }
+
+    // Frames that arrived while their wire buffer was still being sent
+    for (size_t c = 0; c < lightkraken::Model::stripN; c++) {
+        if (lightkraken::Strip::get(c).pendingTransferFlag()) {
+            lightkraken::Strip::get(c).transfer();
+        }
+        lightkraken::Strip::get(c).refresh();
+        lightkraken::Strip::get(c).updateRates();
+    }
+
     switch(Model::instance().outputConfig()) {
-    case Model::OUTPUT_CONFIG_DUAL_STRIP: {
+    case Model::OUTPUT_CONFIG_DUAL_STRIP:
+    case Model::OUTPUT_CONFIG_SPLIT_STRIP:
+    case Model::OUTPUT_CONFIG_MIRROR_STRIP: {
         lightkraken::SPI_2::instance().update();
         lightkraken::SPI_0::instance().update();
     } break;
@@ -717,23 +503,23 @@ void Control::update() {
     default: {
     } break;
     }
+
+#ifdef PARALLEL_OUTPUT
+    // Strips with new data go out together as soon as the port is free
+    lightkraken::Parallel::instance().transfer();
+#endif  // #ifdef PARALLEL_OUTPUT
 }
 
 void Control::init() {
 
-    lightkraken::Strip::get(0).dmaTransferFunc = [](const uint8_t *data, size_t len) {
-        SPI_0::instance().transfer(data, len, lightkraken::Strip::get(0).needsClock());
-    };
-    lightkraken::Strip::get(0).dmaBusyFunc = []() {
-        return SPI_0::instance().busy();
-    };
-
-    lightkraken::Strip::get(1).dmaTransferFunc = [](const uint8_t *data, size_t len) {
-        SPI_2::instance().transfer(data, len, lightkraken::Strip::get(1).needsClock());
-    };
-    lightkraken::Strip::get(1).dmaBusyFunc = []() {
-        return SPI_2::instance().busy();
-    };
+#ifdef PARALLEL_OUTPUT
+    for (size_t c = 0; c < Model::stripN; c++) {
+        lightkraken::Strip::get(c).setParallelLane(c);
+    }
+#else  // #ifdef PARALLEL_OUTPUT
+    lightkraken::Strip::get(0).setSPI(&SPI_0::instance());
+    lightkraken::Strip::get(1).setSPI(&SPI_2::instance());
+#endif  // #ifdef PARALLEL_OUTPUT
     
     DEBUG_PRINTF(("Control up.\n"));
 }
@@ -741,7 +527,7 @@ void Control::init() {
 void Control::startupModePattern() {
     PerfMeasure perf(PerfMeasure::SLOT_SET_DATA);
 	auto effect = [=] (size_t strip) {
-		switch (Model::instance().stripConfig(strip).startup_mode) {
+		switch (Model::instance().outputStripConfig(strip).startup_mode) {
 			case Strip::STARTUP_MODE_COLOR: {	
 				uint8_t buf[Strip::bytesMaxLen];
 				size_t l = lightkraken::Strip::get(strip).getPixelLen();
@@ -749,23 +535,23 @@ void Control::startupModePattern() {
 				for (size_t c = 0; c < l; c++) {
                     switch(cpp) {
                         case 3: {
-                            buf[c*3+0] = Model::instance().stripConfig(strip).color.r;
-                            buf[c*3+1] = Model::instance().stripConfig(strip).color.g;
-                            buf[c*3+2] = Model::instance().stripConfig(strip).color.b;
+                            buf[c*3+0] = Model::instance().outputStripConfig(strip).color.r;
+                            buf[c*3+1] = Model::instance().outputStripConfig(strip).color.g;
+                            buf[c*3+2] = Model::instance().outputStripConfig(strip).color.b;
                         } break;
                         case 4: {
-                            buf[c*4+0] = Model::instance().stripConfig(strip).color.r;
-                            buf[c*4+1] = Model::instance().stripConfig(strip).color.g;
-                            buf[c*4+2] = Model::instance().stripConfig(strip).color.b;
-                            buf[c*4+3] = Model::instance().stripConfig(strip).color.x;
+                            buf[c*4+0] = Model::instance().outputStripConfig(strip).color.r;
+                            buf[c*4+1] = Model::instance().outputStripConfig(strip).color.g;
+                            buf[c*4+2] = Model::instance().outputStripConfig(strip).color.b;
+                            buf[c*4+3] = Model::instance().outputStripConfig(strip).color.x;
                         } break;
                         case 6: {
                             buf[c*6 + 0] = 
-                            buf[c*6 + 1] = (Model::instance().stripConfig(strip).color.r) & 0xFF;
+                            buf[c*6 + 1] = (Model::instance().outputStripConfig(strip).color.r) & 0xFF;
                             buf[c*6 + 2] = 
-                            buf[c*6 + 3] = (Model::instance().stripConfig(strip).color.g) & 0xFF;
+                            buf[c*6 + 3] = (Model::instance().outputStripConfig(strip).color.g) & 0xFF;
                             buf[c*6 + 4] = 
-                            buf[c*6 + 5] = (Model::instance().stripConfig(strip).color.b) & 0xFF;
+                            buf[c*6 + 5] = (Model::instance().outputStripConfig(strip).color.b) & 0xFF;
                         } break;
                     }
                 }
@@ -778,13 +564,12 @@ void Control::startupModePattern() {
 			} break;
 			case Strip::STARTUP_MODE_RAINBOW: {	
 				uint8_t buf[Strip::bytesMaxLen];
-				float h = 1.0f - fmod( Systick::instance().systemTime() / 10000.f, 1.0f);
+				const uq16 h = uq16::one() - uq16::fromRatio(Systick::instance().systemTime() % 10000, 10000);
+				const uq16 step = uq16::fromRatio(1, 255);
 				size_t l = lightkraken::Strip::get(strip).getPixelLen();
                 size_t cpp = lightkraken::Strip::get(strip).getBytesPerPixel();
 				for (size_t c = 0; c < l; c++) {
-					hsv col_hsv(fmod(h + c * (1.0f / 255.0f), 1.0f), 1.0f, 1.0f);
-					rgb col_rgb(col_hsv);
-					rgb8 col_rgb8(col_rgb);
+					rgb8 col_rgb8 = rgb8::hue(h + uq16::fromRaw(step.raw() * uint32_t(c)));
                     switch(cpp) {
                         case 3: {
                             buf[c*3+0] = col_rgb8.red();
@@ -816,11 +601,14 @@ void Control::startupModePattern() {
 			} break;
 			case Strip::STARTUP_MODE_TRACER: {	
 				uint8_t buf[Strip::bytesMaxLen];
-				float h = 1.0f - fmod( Systick::instance().systemTime() / 5000.f, 1.0f);
+				const uq16 h = uq16::one() - uq16::fromRatio(Systick::instance().systemTime() % 5000, 5000);
 				size_t l = lightkraken::Strip::get(strip).getPixelLen();
                 size_t cpp = lightkraken::Strip::get(strip).getBytesPerPixel();
-				for (size_t c = 0; c < l; c++) {
-					size_t i = std::clamp(size_t(l * fmod(h + (c / float(l)), 1.0f)), size_t(0), l);
+				// Position of each pixel along the strip shifted by h, in pixels
+				const uint32_t span = uint32_t(l) << uq16::frac_bits;
+				uint32_t pos = span ? (h.raw() * uint32_t(l)) % span : 0;
+				for (size_t c = 0; c < l; c++, pos = (pos + uq16::one_raw < span) ? pos + uq16::one_raw : pos + uq16::one_raw - span) {
+					size_t i = pos >> uq16::frac_bits;
 					if (i == 0) {
                         switch(cpp) {
                             case 3: {
@@ -876,11 +664,13 @@ void Control::startupModePattern() {
 			} break;
 			case Strip::STARTUP_MODE_SOLID_TRACER: {	
 				uint8_t buf[Strip::bytesMaxLen];
-				float h = 1.0f - fmod( Systick::instance().systemTime() / 5000.f, 1.0f);
+				const uq16 h = uq16::one() - uq16::fromRatio(Systick::instance().systemTime() % 5000, 5000);
 				size_t l = lightkraken::Strip::get(strip).getPixelLen() + 1;
                 size_t cpp = lightkraken::Strip::get(strip).getBytesPerPixel();
-				for (size_t c = 0; c < l; c++) {
-					size_t i = std::clamp(size_t(l * fmod(h + (c / float(l)), 1.0f)), size_t(0), l);
+				const uint32_t span = uint32_t(l) << uq16::frac_bits;
+				uint32_t pos = (h.raw() * uint32_t(l)) % span;
+				for (size_t c = 0; c < l; c++, pos = (pos + uq16::one_raw < span) ? pos + uq16::one_raw : pos + uq16::one_raw - span) {
+					size_t i = pos >> uq16::frac_bits;
 					if (c < i) {
                         switch(cpp) {
                             case 3: {
@@ -939,11 +729,17 @@ void Control::startupModePattern() {
 
     switch(Model::instance().outputConfig()) {
     case Model::OUTPUT_CONFIG_RGB_DUAL_STRIP:
-    case Model::OUTPUT_CONFIG_DUAL_STRIP: {
+    case Model::OUTPUT_CONFIG_DUAL_STRIP:
+    case Model::OUTPUT_CONFIG_SPLIT_STRIP: {
         for (size_t c = 0; c < Model::stripN; c++) {
         	effect(c);
         }
 	} break;
+    case Model::OUTPUT_CONFIG_MIRROR_STRIP: {
+        for (size_t c = 0; c < mirrorStripN; c++) {
+        	effect(c);
+        }
+	} break;
     case Model::OUTPUT_CONFIG_RGB_STRIP:
     case Model::OUTPUT_CONFIG_RGBW_STRIP: {
         for (size_t c = 1; c < Model::stripN; c++) {
@@ -23,7 +23,7 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef CONTROL_H
 #define CONTROL_H
 
-#include <functional>
+#include <array>
 
 #include "./spi.h"
 #include "./model.h"
@@ -47,10 +47,23 @@ public:
     void setEnableSyncMode(bool state) { syncMode = state; }
     bool syncModeEnabled() const { return syncMode; }
 
-    void interateAllActiveArtnetUniverses(std::function<void (uint16_t universe)> callback);
+    // Cycles between the first and the last output started by sync()
+    uint32_t syncSkew() const { return sync_skew; }
+    uint32_t syncSkewMax() const { return sync_skew_max; }
+
+    template<class F> void interateAllActiveArtnetUniverses(F callback) {
+        size_t universeCount = 0;
+        std::array<uint16_t, Model::maxUniverses> universes;
+        collectAllActiveArtnetUniverses(universes, universeCount);
+        for (size_t c = 0; c < universeCount; c++) {
+            callback(universes[c]);
+        }
+    }
     void collectAllActiveArtnetUniverses(std::array<uint16_t, Model::maxUniverses> &universes, size_t &universeCount);
     void collectAllActiveE131Universes(std::array<uint16_t, Model::maxUniverses> &universes, size_t &universeCount);
 
+    void updateRoutes();
+
     void setDataReceived() { data_received = true; }
     bool dataReceived() const { return data_received; }
     void scheduleColor() { color_scheduled = true; }
@@ -60,13 +73,47 @@ public:
 
 private:
 
+    struct Route {
+        uint16_t universe;
+        uint16_t channel;   // terminal component channel, zero based
+        uint8_t target;     // strip or terminal
+        uint8_t slot;       // strip universe slot or terminal component
+        uint8_t input_type;
+        bool terminal;
+    };
+
+    struct RouteTable {
+        std::array<Route, Model::maxUniverses> routes;
+        size_t count;
+    };
+
+    struct Routes {
+        RouteTable artnet;
+        RouteTable e131;
+        bool split_strip;
+    };
+
+    std::array<Routes, 2> routes {};
+    const Routes * volatile active_routes = &routes[0];
+
+    void collectUniverses(const RouteTable &table, std::array<uint16_t, Model::maxUniverses> &universes, size_t &universeCount);
+    void setUniverseOutputData(const Routes &current, const RouteTable &table, uint16_t uni, const uint8_t *data, size_t len, bool nodriver);
+    void startOutputs(size_t strip_first, size_t strip_end, size_t terminals);
+    void transferSplitFrame();
+
+    // Board draw and strip supply efficiency for the PoE power budget
+    static constexpr uint32_t boardPower = 2000;
+    static constexpr uint32_t converterEfficiency = 90;
+    uint32_t powerBudget() const;
+
     bool in_startup = true;
     bool color_scheduled = false;
+    bool join_scheduled = false;
     bool data_received = false;
     bool syncMode = false;
+    uint32_t sync_skew = 0;
+    uint32_t sync_skew_max = 0;
     void setColor(size_t strip, size_t index, const rgb8 &color);
-    void setArtnetUniverseOutputDataForDriver(size_t channels, size_t components, uint16_t uni, const uint8_t *data, size_t len);
-    void setE131UniverseOutputDataForDriver(size_t channels, size_t components, uint16_t uni, const uint8_t *data, size_t len);
     bool initialized = false;
     void init();
 };
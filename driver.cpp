@@ -48,19 +48,29 @@ void Driver::setRGBWW(size_t terminal, const rgbww &rgb) {
     _srgbww[terminal] = rgb;
 }
 
+void Driver::setPWMLimit(size_t terminal, uq16 value) {
+    pwm_limit[terminal] = uint16_t(value.clamp(uq16(), uq16::one()).scale(uint32_t(PwmTimer::pwmPeriod)));
+}
+
 void Driver::sync(size_t terminal) {
+    prepare(terminal);
+    latch();
+}
+
+// Converts into pending pulses only, latch() moves them to the timers.
+void Driver::prepare(size_t terminal) {
     auto convert = [=, this] (const rgbww &rgb) {
         rgbww ret;
-        float limit = Model::instance().analogConfig(terminal).pwm_limit;
+        const uint32_t limit = pwm_limit[terminal];
         auto input_type = Model::instance().analogConfig(terminal).input_type;
         auto output_type = Model::instance().analogConfig(terminal).output_type;
 
         auto scale8bit = [=] (uint16_t in) {
-            return uint16_t(std::min(limit, float(in) * (1.0f / 255.0f)) * (PwmTimer::pwmPeriod));
+            return uint16_t(std::min(limit, (uint32_t(in) * PwmTimer::pwmPeriod) / 0xFF));
         };
 
         auto scale16bit = [=] (uint16_t in) {
-            return uint16_t(std::min(limit, float(in) * (1.0f / 65535.0f)) * (PwmTimer::pwmPeriod));
+            return uint16_t(std::min(limit, (uint32_t(in) * PwmTimer::pwmPeriod) / 0xFFFF));
         };
 
         switch(input_type) {
@@ -308,7 +318,9 @@ void Driver::sync(size_t terminal) {
     };
 
     switch(Model::instance().outputConfig()) {
-    case Model::OUTPUT_CONFIG_DUAL_STRIP: {
+    case Model::OUTPUT_CONFIG_DUAL_STRIP:
+    case Model::OUTPUT_CONFIG_SPLIT_STRIP:
+    case Model::OUTPUT_CONFIG_MIRROR_STRIP: {
     } break;
     case Model::OUTPUT_CONFIG_RGB_STRIP: {
         if (terminal == 0) {
@@ -355,7 +367,21 @@ void Driver::sync(size_t terminal) {
 }
 
 void Driver::setPulse(size_t idx, uint16_t pulse) {
-    idx %= 6;
+    idx %= pulseN;
+    pulses[idx] = pulse;
+    pulses_pending |= 1UL << idx;
+}
+
+void Driver::latch() {
+    for (size_t c = 0; c < pulseN; c++) {
+        if (pulses_pending & (1UL << c)) {
+            writePulse(c, pulses[c]);
+        }
+    }
+    pulses_pending = 0;
+}
+
+void Driver::writePulse(size_t idx, uint16_t pulse) {
     switch(idx) {
     case 0: {
         PwmTimer1::instance().setPulse(pulse);
@@ -384,6 +410,7 @@ void Driver::init() {
     rgbSpace.setsRGB();
     for (size_t c = 0; c < terminalN; c++) {
         colorConverter[c].setRGBColorSpace(rgbSpace);
+        pwm_limit[c] = PwmTimer::pwmPeriod;
     }
 
     PwmTimer0::instance().setPulse(0x0);
@@ -27,6 +27,7 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <string.h>
 
 #include "./color.h"
+#include "./fixed.h"
 
 namespace lightkraken {
 
@@ -57,6 +58,7 @@ public:
     };
 
     constexpr static size_t terminalN = 2;
+    constexpr static size_t pulseN = 6;
     
     static Driver &instance();
 
@@ -64,19 +66,24 @@ public:
     void setRGBWW(size_t terminal, const rgbww &rgb);
 
     void sync(size_t terminal);
+    void prepare(size_t terminal);
+    void latch();
     
     void setRGBColorSpace(size_t terminal, const RGBColorSpace &rgbSpace) { colorConverter[terminal].setRGBColorSpace(rgbSpace); }
-    void setPWMLimit(size_t terminal, float value) { pwm_limit[terminal] = value; }
+    void setPWMLimit(size_t terminal, uq16 value);
 
 private:
     void setPulse(size_t idx, uint16_t pulse);
+    void writePulse(size_t idx, uint16_t pulse);
 
     bool initialized = false;
     void init();
     
     rgbww _srgbww[terminalN];
-    float pwm_limit[terminalN];
+    uint16_t pwm_limit[terminalN];
     ColorSpaceConverter colorConverter[terminalN]; 
+    uint16_t pulses[pulseN];
+    uint32_t pulses_pending = 0;
 };
 
 };
@@ -175,7 +175,7 @@ void EthernetIf::low_level_init(struct netif *netif, uint32_t mac_addr) {
     enet_enable();
 }
 
-__attribute__ ((hot, flatten, optimize("O3"), optimize("unroll-loops")))
+__attribute__ ((hot, flatten, optimize("O3"), optimize("unroll-loops"))) RAMFUNC
 static void memcpy_fast_aligned(uint8_t * dst, const uint8_t *src, size_t len) {
     uint8_t *d = (uint8_t *)__builtin_assume_aligned (dst, 4);
     const uint8_t *s = (const uint8_t *)__builtin_assume_aligned (src, 4);
@@ -202,7 +202,7 @@ err_t EthernetIf::low_level_output(struct netif *netif, struct pbuf *p) {
     return ERR_OK;
 }
 
-struct pbuf *EthernetIf::low_level_input(struct netif *netif) {
+RAMFUNC struct pbuf *EthernetIf::low_level_input(struct netif *netif) {
     (void)netif;
 
     u16_t len = enet_desc_information_get(dma_current_rxdesc, RXDESC_FRAME_LENGTH);
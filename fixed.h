@@ -0,0 +1,99 @@
+/*
+Copyright 2019 Tinic Uro
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef FIXED_H_
+#define FIXED_H_
+
+#include <stdint.h>
+#include <limits>
+#include <type_traits>
+
+namespace lightkraken {
+
+// Q-format fixed point: a T holding the value times 2^F. We are built with
+// -mfloat-abi=soft, so floats are converted once when the configuration is
+// applied and everything running per packet or per frame stays integer.
+template<typename T, int F>
+class fixed {
+public:
+    using raw_type = T;
+    using wide_type = std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>;
+
+    static constexpr int frac_bits = F;
+    static constexpr T one_raw = T(T(1) << F);
+
+    constexpr fixed() : v(0) {}
+
+    static constexpr fixed fromRaw(T raw) { fixed r; r.v = raw; return r; }
+    // Shifting a negative value is undefined, so through the unsigned type
+    static constexpr fixed fromInt(T i) { return fromRaw(T(std::make_unsigned_t<T>(std::make_unsigned_t<T>(i) << F))); }
+    static constexpr fixed fromRatio(wide_type num, wide_type den) { return fromRaw(T((num * (wide_type(1) << F)) / den)); }
+    static constexpr fixed one() { return fromRaw(one_raw); }
+
+    // Config time only, pulls in soft-float. Values come straight from the
+    // settings, so they saturate to the range of the format and NaN is 0.
+    static constexpr fixed fromFloat(float f) {
+        if (f != f) {
+            return fixed();
+        }
+        const float r = f * float(one_raw) + (f < 0.0f ? -0.5f : 0.5f);
+        if (r <= float(std::numeric_limits<T>::min())) {
+            return fromRaw(std::numeric_limits<T>::min());
+        }
+        if (r >= float(std::numeric_limits<T>::max())) {
+            return fromRaw(std::numeric_limits<T>::max());
+        }
+        return fromRaw(T(r));
+    }
+
+    constexpr T raw() const { return v; }
+    constexpr T integer() const { return T(v >> F); }
+    constexpr fixed frac() const { return fromRaw(T(v & (one_raw - 1))); }
+
+    constexpr fixed clamp(fixed lo, fixed hi) const {
+        return v < lo.v ? lo : (hi.v < v ? hi : *this);
+    }
+
+    // i * value, rounded towards negative infinity
+    template<typename I> constexpr I scale(I i) const {
+        return I((wide_type(i) * wide_type(v)) >> F);
+    }
+
+    constexpr fixed operator+(fixed o) const { return fromRaw(T(v + o.v)); }
+    constexpr fixed operator-(fixed o) const { return fromRaw(T(v - o.v)); }
+    constexpr fixed operator*(fixed o) const { return fromRaw(T((wide_type(v) * wide_type(o.v)) >> F)); }
+
+    constexpr bool operator==(fixed o) const { return v == o.v; }
+    constexpr bool operator!=(fixed o) const { return v != o.v; }
+    constexpr bool operator<(fixed o) const { return v < o.v; }
+    constexpr bool operator>(fixed o) const { return v > o.v; }
+
+private:
+    T v;
+};
+
+using q16 = fixed<int32_t, 16>;     // Q15.16
+using uq16 = fixed<uint32_t, 16>;   // UQ16.16, fractions and turns
+
+}
+
+#endif /* FIXED_H_ */
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Fails the build if a function on a per packet or per frame path calls into
+# the soft-float library. Takes the objdump -D listing of the firmware.
+# Config time code (Model, REST, color space setup) is free to use floats,
+# the per pixel color conversion is not.
+
+dump="$1"
+
+hot='^_ZZ?N11lightkraken(5Strip|3SPI|5SPI_[02]|6Driver|7Control|4rgb8|12ArtNetPacket|10sACNPacket|[0-9]+PwmTimer[0-9]?|19ColorSpaceConverter(13sRGB8toLEDPWM|9mul_fixed|9dot_fixed))'
+soft='<(__aeabi_[fd][a-z0-9]+|__aeabi_u?[il]2[fd]|fmodf?|powf?|expf?|logf?)>'
+
+awk -v hot="$hot" -v soft="$soft" '
+/^[0-9a-f]+ <[^>]*>:$/ { fn = $2; gsub(/[<>:]/, "", fn); next }
+fn ~ hot && $0 ~ soft { print "soft-float in " fn ": " $NF; bad = 1 }
+END { exit bad }
+' "$dump"
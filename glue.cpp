@@ -4,7 +4,49 @@ extern "C" {
 
 #include "./systick.h"
 
+#ifdef MALLOC_TRAP
+#include <stddef.h>
+#endif  // #ifdef MALLOC_TRAP
+
 extern "C" {
+
+#ifdef MALLOC_TRAP
+// Linked with --wrap so that every newlib allocation, including the ones
+// made by operator new and stdio, goes through here.
+struct _reent;
+
+static bool heap_locked = false;
+
+void lock_heap(void) {
+    heap_locked = true;
+}
+
+void *__real__malloc_r(struct _reent *, size_t);
+void *__real__calloc_r(struct _reent *, size_t, size_t);
+void *__real__realloc_r(struct _reent *, void *, size_t);
+
+void *__wrap__malloc_r(struct _reent *r, size_t size) {
+    if (heap_locked) {
+        __builtin_trap();
+    }
+    return __real__malloc_r(r, size);
+}
+
+void *__wrap__calloc_r(struct _reent *r, size_t n, size_t size) {
+    if (heap_locked) {
+        __builtin_trap();
+    }
+    return __real__calloc_r(r, n, size);
+}
+
+void *__wrap__realloc_r(struct _reent *r, void *ptr, size_t size) {
+    if (heap_locked) {
+        __builtin_trap();
+    }
+    return __real__realloc_r(r, ptr, size);
+}
+#endif  // #ifdef MALLOC_TRAP
+
 u32_t sys_now(void) {
     return lightkraken::Systick::instance().systemTime();
 }
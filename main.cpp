@@ -67,6 +67,15 @@ int main() {
 
     nvic_vector_table_set(NVIC_BASE_ADDRESS,0);
 
+#if defined(STRIP_BENCHMARK) && !defined(BOOTLOADER)
+    lightkraken::Strip::benchmark();
+    lightkraken::Model::instance().apply();
+#endif  // #if defined(STRIP_BENCHMARK) && !defined(BOOTLOADER)
+
+#ifdef MALLOC_TRAP
+    bool heap_locked = false;
+#endif  // #ifdef MALLOC_TRAP
+
     while (1) {
         lightkraken::NetConf::instance().update();
         lightkraken::StatusLED::instance().update();
@@ -74,6 +83,14 @@ int main() {
 #ifndef BOOTLOADER
 		lightkraken::Control::instance().update();
 #endif  //#ifndef BOOTLOADER
+
+#ifdef MALLOC_TRAP
+        // All singletons are up after the first pass, nothing may allocate from here on
+        if (!heap_locked) {
+            heap_locked = true;
+            lock_heap();
+        }
+#endif  // #ifdef MALLOC_TRAP
     }
     return 0;
 }
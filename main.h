@@ -29,4 +29,23 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define DEBUG_PRINTF(x)
 #endif  // #ifndef BOOTLOADER
 
+// Hot code and the tables it reads per component can run from RAM. Both
+// land in .data and are copied there by the startup code. Code only goes
+// there with RAM_KERNELS, compare Strip::benchmark() with and without it.
+#if defined(RAM_KERNELS) && !defined(BOOTLOADER)
+#define RAMFUNC __attribute__((section(".ramfunc"), noinline))
+#else  // #if defined(RAM_KERNELS) && !defined(BOOTLOADER)
+#define RAMFUNC
+#endif  // #if defined(RAM_KERNELS) && !defined(BOOTLOADER)
+
+#ifndef BOOTLOADER
+#define RAMDATA __attribute__((section(".ramdata")))
+#else  // #ifndef BOOTLOADER
+#define RAMDATA
+#endif  // #ifndef BOOTLOADER
+
+#ifdef MALLOC_TRAP
+extern "C" void lock_heap(void);
+#endif  // #ifdef MALLOC_TRAP
+
 #endif  // #ifndef MAIN_H_
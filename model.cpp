@@ -139,6 +139,14 @@ void Model::defaults() {
 
     burst_mode = true;
 
+    frame_timeout = 20;
+
+    refresh_interval = 1000;
+
+    content_hash = true;
+
+    power_limit = false;
+
     int32_t artnetcounter = 0;
     int32_t e131counter = 1;
 
@@ -151,6 +159,7 @@ void Model::defaults() {
         strip_config[c].glob_illum = 1.0f;
         lightkraken::Strip::get(c).setStripType(Strip::OutputType(strip_config[c].output_type));
         strip_config[c].len = 256;
+        strip_config[c].start_channel = 1;
         strip_config[c].color = rgb8();
         strip_config[c].rgbSpace.setsRGB();
         lightkraken::Strip::get(c).setPixelLen(strip_config[c].len);
@@ -175,16 +184,43 @@ void Model::defaults() {
     }
 }
 
+// The first output takes the first half of the universes, rounded up, the
+// second one the rest.
+size_t Model::splitUniverses() const {
+    const StripConfig &config = strip_config[0];
+    const size_t len = Strip::universePixelLen(Strip::InputType(config.input_type)) * std::max(size_t(1), size_t(config.map.group));
+    const size_t universes = (size_t(config.len) + len - 1) / len;
+    return std::min((universes + 1) / 2, universeN);
+}
+
 void Model::apply() {
 
     for (size_t c = 0; c < stripN; c++) {
-    strip_config[c].rgbSpace.setsRGB();
-        lightkraken::Strip::get(c).setStripType(Strip::OutputType(strip_config[c].output_type));
-        lightkraken::Strip::get(c).setStartupMode(Strip::StartupMode(strip_config[c].startup_mode));
-        lightkraken::Strip::get(c).setPixelLen(strip_config[c].len);
-        lightkraken::Strip::get(c).setRGBColorSpace(strip_config[c].rgbSpace);
-        lightkraken::Strip::get(c).setCompLimit(strip_config[c].comp_limit);
-        lightkraken::Strip::get(c).setGlobIllum(strip_config[c].glob_illum);
+        StripConfig &config = outputStripConfig(c);
+        config.rgbSpace.setsRGB();
+        size_t len = config.len;
+        Model::StripConfig::PixelMap map = config.map;
+        size_t start_channel = config.start_channel;
+        bool continuous = config.continuous;
+        if (splitStrip()) {
+            // Halves split on a universe boundary; only grouping carries over
+            const size_t head = std::min(len, splitUniverses() * Strip::universePixelLen(Strip::InputType(config.input_type)) * std::max(size_t(1), size_t(map.group)));
+            len = (c == 0) ? head : len - head;
+            map = { 0, 0, 0, 0, 0, 0, map.group };
+            start_channel = 1;
+            continuous = false;
+        }
+        lightkraken::Strip::get(c).setStripType(Strip::OutputType(config.output_type));
+        lightkraken::Strip::get(c).setInputType(Strip::InputType(config.input_type));
+        lightkraken::Strip::get(c).setStartupMode(Strip::StartupMode(config.startup_mode));
+        lightkraken::Strip::get(c).setPixelLen(len);
+        lightkraken::Strip::get(c).setPixelMap(map);
+        lightkraken::Strip::get(c).setStartChannel(start_channel, continuous);
+        lightkraken::Strip::get(c).setRGBColorSpace(config.rgbSpace);
+        lightkraken::Strip::get(c).setCompLimit(uq16::fromFloat(config.comp_limit));
+        lightkraken::Strip::get(c).setGlobIllum(uq16::fromFloat(config.glob_illum));
+        lightkraken::Strip::get(c).setFpsLimit(config.fps_limit);
+        lightkraken::Strip::get(c).setInterpolation(config.interpolate);
     }
 
     for (size_t c = 0; c < analogN; c++) {
@@ -196,9 +232,11 @@ void Model::apply() {
         col.ww = analog_config[c].components[4].value;
         Driver::instance().setRGBWW(c, col);
         Driver::instance().setRGBColorSpace(c, analog_config[c].rgbSpace);
-        Driver::instance().setPWMLimit(c, analog_config[c].pwm_limit);
+        Driver::instance().setPWMLimit(c, uq16::fromFloat(analog_config[c].pwm_limit));
     }
 
+    Control::instance().updateRoutes();
+
     Control::instance().setColor();
 
     lightkraken::Control::instance().sync();
@@ -226,7 +264,7 @@ void Model::init() {
 }
 
 void Model::setOutputConfig(OutputConfig outputConfig) {
-    output_config = std::clamp(outputConfig, OUTPUT_CONFIG_DUAL_STRIP, OUTPUT_CONFIG_RGBWWW);
+    output_config = std::clamp(outputConfig, OUTPUT_CONFIG_DUAL_STRIP, OUTPUT_CONFIG_MIRROR_STRIP);
 }
 
 Model &Model::instance() {
@@ -37,7 +37,7 @@ private:
     uint32_t model_version;
 
 public:
-    static constexpr uint32_t currentModelVersion = 0x1ed50002;
+    static constexpr uint32_t currentModelVersion = 0x1ed5000a;
 
     static constexpr size_t stripN = 2;
     static constexpr size_t analogN = 2;
@@ -72,6 +72,19 @@ public:
         rgb8 color;
         RGBColorSpace rgbSpace;
         uint16_t len;
+        struct PixelMap {
+            uint16_t width;         // pixels per row, 0 for a single row
+            uint16_t height;        // rows, 0 for as many as fit
+            uint16_t offset;        // physical pixels before the first row
+            uint16_t gap;           // dead physical pixels between rows
+            uint8_t serpentine;     // odd rows run backwards
+            uint8_t reverse;        // input is wired to the far end
+            uint8_t group;          // physical pixels per input pixel, 0 for 1
+        } map;
+        uint16_t start_channel;     // first DMX channel in the first universe
+        uint8_t continuous;         // pixels run on across universe boundaries
+        uint16_t fps_limit;         // frames per second cap, 0 for none
+        uint8_t interpolate;        // blend between frames while the wire is idle
         uint16_t artnet[universeN];
         uint16_t e131[universeN];
     };
@@ -83,6 +96,8 @@ public:
         OUTPUT_CONFIG_RGBW_STRIP, 	    // channel0: single	    channel1: rgbw
         OUTPUT_CONFIG_RGB_RGB, 	        // channel0: rgb 	    channel1: rgb
         OUTPUT_CONFIG_RGBWWW, 	        // channel0: rgbwww 	
+        OUTPUT_CONFIG_SPLIT_STRIP,      // channel0: strip head channel1: strip tail
+        OUTPUT_CONFIG_MIRROR_STRIP,     // channel0: strip      channel1: same strip
     };
 
     static Model &instance();
@@ -94,6 +109,18 @@ public:
     
     bool burstMode() const { return burst_mode; }
 
+    uint32_t frameTimeout() const { return frame_timeout; }
+    void setFrameTimeout(uint32_t timeout) { frame_timeout = timeout; }
+
+    uint32_t refreshInterval() const { return refresh_interval; }
+    void setRefreshInterval(uint32_t interval) { refresh_interval = interval; }
+
+    bool contentHash() const { return content_hash; }
+    void setContentHash(bool state) { content_hash = state; }
+
+    bool powerLimit() const { return power_limit; }
+    void setPowerLimit(bool state) { power_limit = state; }
+
     bool dhcpEnabled() const { return dhcp; }
     void setDhcpEnabled(bool state) { dhcp = state; }
     
@@ -108,6 +135,12 @@ public:
     ip_addr_t *ip4Gateway() { return &ip4_gateway; }
     
     StripConfig &stripConfig(size_t index) { return strip_config[index]; }
+
+    // In split and mirror mode both outputs drive the strip in the first config
+    bool splitStrip() const { return output_config == OUTPUT_CONFIG_SPLIT_STRIP; }
+    bool sharedStrip() const { return splitStrip() || output_config == OUTPUT_CONFIG_MIRROR_STRIP; }
+    StripConfig &outputStripConfig(size_t index) { return strip_config[sharedStrip() ? 0 : index]; }
+    size_t splitUniverses() const;
     AnalogConfig &analogConfig(size_t index) { return analog_config[index]; }
 
     OutputConfig outputConfig() const { return output_config; }
@@ -144,6 +177,11 @@ private:
     OutputConfig output_config;
 
     bool burst_mode;
+
+    uint32_t frame_timeout;
+    uint32_t refresh_interval;
+    bool content_hash;
+    bool power_limit;
     
     StripConfig strip_config[stripN];
     AnalogConfig analog_config[analogN];
@@ -0,0 +1,271 @@
+/*
+Copyright 2019 Tinic Uro
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+extern "C" {
+#include "gd32f10x.h"
+}
+
+#include <algorithm>
+
+#include "./main.h"
+#include "./parallel.h"
+#include "./systick.h"
+
+extern "C" uint32_t SystemCoreClock;
+
+extern "C" {
+
+__attribute__((used))
+void DMA1_Channel3_IRQHandler() {
+    if(dma_interrupt_flag_get(DMA1, DMA_CH3, DMA_INT_FLAG_HTF)) {
+        dma_interrupt_flag_clear(DMA1, DMA_CH3, DMA_INT_FLAG_HTF);
+        lightkraken::Parallel::instance().dmaHalfDone();
+    }
+    if(dma_interrupt_flag_get(DMA1, DMA_CH3, DMA_INT_FLAG_FTF)) {
+        dma_interrupt_flag_clear(DMA1, DMA_CH3, DMA_INT_FLAG_FTF);
+        dma_interrupt_flag_clear(DMA1, DMA_CH3, DMA_INT_FLAG_G);
+        lightkraken::Parallel::instance().dmaDone();
+    }
+}
+
+}
+
+namespace lightkraken {
+
+// The port comes from the build, there is no default: the stock board has
+// no port with eight free pins in a row.
+#if !defined(PARALLEL_PORT) || !defined(PARALLEL_PORT_CLOCK)
+#error "PARALLEL_OUTPUT needs PARALLEL_PORT and PARALLEL_PORT_CLOCK of the target board"
+#endif  // #if !defined(PARALLEL_PORT) || !defined(PARALLEL_PORT_CLOCK)
+
+static constexpr uint32_t lanePort = PARALLEL_PORT;
+static constexpr rcu_periph_enum lanePortClock = PARALLEL_PORT_CLOCK;
+static constexpr uint32_t lanePins = ((1UL << Parallel::laneN) - 1) << Parallel::firstPin;
+
+// TIMER4 compare events request the three port writes of every bit:
+//   CH0 at 0    DMA1 CH4  pin mask to GPIO_BOP, all lanes high
+//   CH1 at T0H  DMA1 CH3  slot to GPIO_BC, lanes sending a zero low
+//   CH3 at T1H  DMA1 CH0  pin mask to GPIO_BC, all lanes low
+// TIMER4 CH2 and UP share DMA1 CH1 with SPI2 and stay unused.
+
+static void dma_setup(dma_channel_enum channel, volatile uint32_t *periph, const void *memory,
+                      uint32_t number, uint32_t memory_width, uint32_t memory_inc) {
+    dma_deinit(DMA1, channel);
+    dma_parameter_struct dma_init_struct;
+    dma_struct_para_init(&dma_init_struct);
+    dma_init_struct.periph_addr  = (uint32_t)periph;
+    dma_init_struct.memory_addr  = (uint32_t)memory;
+    dma_init_struct.direction    = DMA_MEMORY_TO_PERIPHERAL;
+    dma_init_struct.memory_width = memory_width;
+    dma_init_struct.periph_width = DMA_PERIPHERAL_WIDTH_32BIT;
+    dma_init_struct.priority     = DMA_PRIORITY_ULTRA_HIGH;
+    dma_init_struct.number       = number;
+    dma_init_struct.periph_inc   = DMA_PERIPH_INCREASE_DISABLE;
+    dma_init_struct.memory_inc   = memory_inc;
+    dma_init(DMA1, channel, &dma_init_struct);
+    dma_circulation_enable(DMA1, channel);
+    dma_memory_to_memory_disable(DMA1, channel);
+}
+
+Parallel &Parallel::instance() {
+    static Parallel parallel;
+    if (!parallel.initialized) {
+        parallel.initialized = true;
+        parallel.init();
+    }
+    return parallel;
+}
+
+void Parallel::setLane(size_t lane, Source *source) {
+    if (lane < laneN) {
+        lanes[lane] = source;
+    }
+}
+
+// The lanes have to stay low for the reset time between two frames
+bool Parallel::busy() const {
+    if (active) {
+        return true;
+    }
+    const uint64_t reset_ticks = uint64_t(timing.reset_us) * (SystemCoreClock / 1000000);
+    return (Systick::instance().systemTick() - idle_tick) < reset_ticks;
+}
+
+// Starts a frame on all lanes which have data, false if the previous one is
+// still going out.
+bool Parallel::transfer() {
+    if (busy()) {
+        return false;
+    }
+    // All lanes run off the same timer. The first lane which can be sent
+    // sets the bit timing, whether it has a frame right now or not, and
+    // lanes needing another one are left out. The reset is the longest.
+    Timing next {};
+    bool timed = false;
+    uint32_t refused = 0;
+    lane_mask = 0;
+    frame_len = 0;
+    for (size_t c = 0; c < laneN; c++) {
+        Timing lane_timing {};
+        if (!lanes[c] || !lanes[c]->laneTiming(lane_timing)) {
+            continue;
+        }
+        if (!timed) {
+            next = lane_timing;
+            timed = true;
+        } else if (lane_timing.t0h_ns != next.t0h_ns || lane_timing.t1h_ns != next.t1h_ns ||
+                   lane_timing.bit_ns != next.bit_ns) {
+            refused |= 1UL << c;
+            continue;
+        }
+        next.reset_us = std::max(next.reset_us, lane_timing.reset_us);
+        const size_t len = lanes[c]->laneBegin();
+        if (!len) {
+            continue;
+        }
+        lane_mask |= 1UL << c;
+        frame_len = std::max(frame_len, len);
+    }
+    if (refused != refused_mask) {
+        refused_mask = refused;
+        if (refused) {
+            DEBUG_PRINTF(("Parallel lanes %04x left out, their bit timing differs from the first lane.\n", unsigned(refused)));
+        }
+    }
+    if (!lane_mask) {
+        return false;
+    }
+    timing = next;
+    pin_mask = lane_mask << firstPin;
+    // Prime both halves of the ring, the DMA interrupts take it from there
+    stream_pos = 0;
+    fill(ring.data());
+    fill(ring.data() + ringLen / 2);
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    start();
+    __set_PRIMASK(primask);
+    return true;
+}
+
+void Parallel::dmaHalfDone() {
+    if (active && !fill(ring.data())) {
+        stop();
+    }
+}
+
+void Parallel::dmaDone() {
+    if (active && !fill(ring.data() + ringLen / 2)) {
+        stop();
+    }
+}
+
+// Called from the DMA interrupt with the half of the ring which was just
+// sent out; fills it with the next part of the frame, zero bits past its
+// end. The frame is complete once the half holding its end is done.
+__attribute__ ((hot, optimize("O3"))) RAMFUNC
+bool Parallel::fill(Slot *dst) {
+    if (stream_pos >= frame_len + halfComps) {
+        return false;
+    }
+    std::array<const uint8_t *, laneN> src;
+    for (size_t c = 0; c < laneN; c++) {
+        if (lane_mask & (1UL << c)) {
+            lanes[c]->laneComps(comps[c].data(), stream_pos, halfComps);
+        } else {
+            comps[c].fill(0);
+        }
+        src[c] = comps[c].data();
+    }
+    encodeSlots(dst, src.data(), halfComps);
+    stream_pos += halfComps;
+    return true;
+}
+
+void Parallel::start() {
+    // APB1 timers run at twice the bus clock unless APB1 is undivided
+    const uint32_t apb1 = rcu_clock_freq_get(CK_APB1);
+    const uint32_t clock = apb1 == rcu_clock_freq_get(CK_AHB) ? apb1 : apb1 * 2;
+    auto ticks = [clock] (uint32_t ns) {
+        return uint16_t((uint64_t(clock) * ns + 500000000) / 1000000000);
+    };
+    const uint16_t period = uint16_t(ticks(timing.bit_ns) - 1);
+
+    timer_disable(TIMER4);
+    timer_deinit(TIMER4);
+    timer_parameter_struct timer_initpara;
+    timer_initpara.prescaler         = 0;
+    timer_initpara.alignedmode       = TIMER_COUNTER_EDGE;
+    timer_initpara.counterdirection  = TIMER_COUNTER_UP;
+    timer_initpara.period            = period;
+    timer_initpara.clockdivision     = TIMER_CKDIV_DIV1;
+    timer_initpara.repetitioncounter = 0;
+    timer_init(TIMER4, &timer_initpara);
+
+    timer_channel_output_mode_config(TIMER4, TIMER_CH_0, TIMER_OC_MODE_TIMING);
+    timer_channel_output_mode_config(TIMER4, TIMER_CH_1, TIMER_OC_MODE_TIMING);
+    timer_channel_output_mode_config(TIMER4, TIMER_CH_3, TIMER_OC_MODE_TIMING);
+    timer_channel_output_pulse_value_config(TIMER4, TIMER_CH_0, 0);
+    timer_channel_output_pulse_value_config(TIMER4, TIMER_CH_1, ticks(timing.t0h_ns));
+    timer_channel_output_pulse_value_config(TIMER4, TIMER_CH_3, ticks(timing.t1h_ns));
+
+    dma_setup(DMA_CH4, &GPIO_BOP(lanePort), &pin_mask, 1, DMA_MEMORY_WIDTH_32BIT, DMA_MEMORY_INCREASE_DISABLE);
+    dma_setup(DMA_CH3, &GPIO_BC(lanePort), ring.data(), ringLen,
+              sizeof(Slot) == 1 ? DMA_MEMORY_WIDTH_8BIT : DMA_MEMORY_WIDTH_16BIT, DMA_MEMORY_INCREASE_ENABLE);
+    dma_setup(DMA_CH0, &GPIO_BC(lanePort), &pin_mask, 1, DMA_MEMORY_WIDTH_32BIT, DMA_MEMORY_INCREASE_DISABLE);
+    dma_interrupt_enable(DMA1, DMA_CH3, DMA_INT_HTF);
+    dma_interrupt_enable(DMA1, DMA_CH3, DMA_INT_FTF);
+    nvic_irq_enable(DMA1_Channel3_IRQn, 0, 0);
+
+    dma_channel_enable(DMA1, DMA_CH4);
+    dma_channel_enable(DMA1, DMA_CH3);
+    dma_channel_enable(DMA1, DMA_CH0);
+    timer_dma_enable(TIMER4, TIMER_DMA_CH0D | TIMER_DMA_CH1D | TIMER_DMA_CH3D);
+
+    // Wraps to 0 on the first tick, so the first bit starts with its high
+    timer_counter_value_config(TIMER4, period);
+    active = true;
+    timer_enable(TIMER4);
+}
+
+void Parallel::stop() {
+    timer_disable(TIMER4);
+    timer_dma_disable(TIMER4, TIMER_DMA_CH0D | TIMER_DMA_CH1D | TIMER_DMA_CH3D);
+    dma_channel_disable(DMA1, DMA_CH4);
+    dma_channel_disable(DMA1, DMA_CH3);
+    dma_channel_disable(DMA1, DMA_CH0);
+    dma_interrupt_flag_clear(DMA1, DMA_CH3, DMA_INT_FLAG_G);
+    GPIO_BC(lanePort) = lanePins;
+    idle_tick = Systick::instance().systemTick();
+    active = false;
+}
+
+void Parallel::init() {
+    rcu_periph_clock_enable(lanePortClock);
+    rcu_periph_clock_enable(RCU_TIMER4);
+    rcu_periph_clock_enable(RCU_DMA1);
+
+    gpio_init(lanePort, GPIO_MODE_OUT_PP, GPIO_OSPEED_50MHZ, lanePins);
+    GPIO_BC(lanePort) = lanePins;
+}
+
+}
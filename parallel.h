@@ -0,0 +1,159 @@
+/*
+Copyright 2019 Tinic Uro
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <type_traits>
+
+// Lane count and first lane pin, the port itself is only needed by
+// parallel.cpp. All of them are set by the build for the target board.
+#ifndef PARALLEL_LANES
+#define PARALLEL_LANES 8
+#endif  // #ifndef PARALLEL_LANES
+
+#ifndef PARALLEL_FIRST_PIN
+#define PARALLEL_FIRST_PIN 0
+#endif  // #ifndef PARALLEL_FIRST_PIN
+
+namespace lightkraken {
+
+// Drives clockless strips at once from pins firstPin to firstPin + laneN - 1
+// of one GPIO port. A timer triggers three DMA writes per bit: all lanes high
+// through GPIO_BOP, the lanes sending a zero low at T0H through GPIO_BC and
+// all lanes low at T1H. Only the middle write carries data, one slot per
+// bit, which the transpose below produces from the component bytes.
+//
+// Not for the stock board: the 64 pin GD32F107RC has no free run of eight
+// pins on any port. Each strip gets one lane, so only the first
+// Model::stripN lanes ever carry data and the others stay low.
+class Parallel {
+public:
+
+    static constexpr size_t laneN = PARALLEL_LANES;
+    static constexpr size_t firstPin = PARALLEL_FIRST_PIN;
+    static_assert(laneN == 8 || laneN == 16, "Lanes come in groups of 8, up to a whole port");
+    static_assert(firstPin % 8 == 0 && firstPin + laneN <= 16, "Lanes start at pin 0 or 8 and fit into the port");
+
+    // One port write per bit, a set bit clears that lane at T0H
+    using Slot = std::conditional_t<(firstPin + laneN > 8), uint16_t, uint8_t>;
+
+    struct Timing {
+        uint32_t t0h_ns;
+        uint32_t t1h_ns;
+        uint32_t bit_ns;
+        uint32_t reset_us;
+    };
+
+    class Source {
+    public:
+        // Bit timing the lane needs, false if it can't be sent this way
+        virtual bool laneTiming(Timing &timing) const = 0;
+        // A frame starts: returns the component bytes the lane sends, 0 if
+        // there is nothing to send.
+        virtual size_t laneBegin() = 0;
+        // Component bytes [pos, pos + len) of the frame, zero past its end
+        virtual void laneComps(uint8_t *dst, size_t pos, size_t len) = 0;
+    };
+
+    static Parallel &instance();
+
+    void setLane(size_t lane, Source *source);
+    bool transfer();
+    bool busy() const;
+
+    // Lanes left out because their timing differs from the first lane's
+    uint32_t refusedLanes() const { return refused_mask; }
+
+    void dmaHalfDone();
+    void dmaDone();
+
+    // Transposes an 8x8 bit matrix, MSB first: bit s of out[t] is bit 7 - t
+    // of in[s]. Six shift and mask steps on two words instead of 64 single
+    // bit moves.
+    static void transpose8x8(const uint8_t *in, uint8_t *out) {
+        uint32_t x = (uint32_t(in[7]) << 24) | (uint32_t(in[6]) << 16) | (uint32_t(in[5]) << 8) | uint32_t(in[4]);
+        uint32_t y = (uint32_t(in[3]) << 24) | (uint32_t(in[2]) << 16) | (uint32_t(in[1]) << 8) | uint32_t(in[0]);
+        uint32_t t;
+
+        t = (x ^ (x >> 7)) & 0x00AA00AA; x = x ^ t ^ (t << 7);
+        t = (y ^ (y >> 7)) & 0x00AA00AA; y = y ^ t ^ (t << 7);
+
+        t = (x ^ (x >> 14)) & 0x0000CCCC; x = x ^ t ^ (t << 14);
+        t = (y ^ (y >> 14)) & 0x0000CCCC; y = y ^ t ^ (t << 14);
+
+        t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+        y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+        x = t;
+
+        out[0] = uint8_t(x >> 24); out[1] = uint8_t(x >> 16); out[2] = uint8_t(x >> 8); out[3] = uint8_t(x);
+        out[4] = uint8_t(y >> 24); out[5] = uint8_t(y >> 16); out[6] = uint8_t(y >> 8); out[7] = uint8_t(y);
+    }
+
+    // Turns len component bytes of every lane into len * 8 slots in wire
+    // order. Lanes are zero bits unless they send a one.
+    static void encodeSlots(Slot *dst, const uint8_t *const *lanes, size_t len) {
+        for (size_t c = 0; c < len; c++, dst += 8) {
+            for (size_t g = 0; g < laneN / 8; g++) {
+                const uint8_t *const *l = lanes + g * 8;
+                const uint8_t in[8] = { l[0][c], l[1][c], l[2][c], l[3][c], l[4][c], l[5][c], l[6][c], l[7][c] };
+                uint8_t out[8];
+                transpose8x8(in, out);
+                for (size_t t = 0; t < 8; t++) {
+                    const Slot zeros = Slot(Slot(uint8_t(~out[t])) << (firstPin + 8 * g));
+                    dst[t] = g ? Slot(dst[t] | zeros) : zeros;
+                }
+            }
+        }
+    }
+
+private:
+
+    // Component bytes per lane in each half of the ring
+    static constexpr size_t halfComps = 48;
+    static constexpr size_t ringLen = halfComps * 8 * 2;
+
+    bool fill(Slot *dst);
+    void start();
+    void stop();
+    void init();
+
+    bool initialized = false;
+    volatile bool active = false;
+    std::array<Source *, laneN> lanes {};
+    uint32_t lane_mask = 0;
+    uint32_t pin_mask = 0;
+    uint32_t refused_mask = 0;
+    size_t frame_len = 0;
+    size_t stream_pos = 0;
+    Timing timing {};
+    uint64_t idle_tick = 0;
+    std::array<std::array<uint8_t, halfComps>, laneN> comps {};
+    std::array<Slot, ringLen> ring {};
+};
+
+}
+
+#endif  // #ifndef PARALLEL_H
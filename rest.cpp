@@ -124,6 +124,22 @@ public:
             Model::instance().setOutputConfig(Model::OutputConfig(int(atof(buf))));
         }
 
+        if (mjson_get_number(post_buf, post_len, "$.frametimeout", &dval) > 0) {
+            Model::instance().setFrameTimeout(uint32_t(std::clamp(int(dval), 0, 1000)));
+        }
+
+        if (mjson_get_number(post_buf, post_len, "$.refreshinterval", &dval) > 0) {
+            Model::instance().setRefreshInterval(uint32_t(std::clamp(int(dval), 0, 60000)));
+        }
+
+        if (mjson_get_bool(post_buf, post_len, "$.contenthash", &ival) > 0) {
+            Model::instance().setContentHash(ival ? true : false);
+        }
+
+        if (mjson_get_bool(post_buf, post_len, "$.powerlimit", &ival) > 0) {
+            Model::instance().setPowerLimit(ival ? true : false);
+        }
+
         for (int c=0; c<int(Model::analogN); c++) {
             Model::AnalogConfig &config = Model::instance().analogConfig(c);
 
@@ -283,9 +299,9 @@ public:
 
             sprintf(ss, "$.stripconfig[%d].length", c);
             if (mjson_get_number(post_buf, post_len, ss, &dval) > 0) {
-                config.len = std::clamp(int(dval), 0, 1023);
+                config.len = std::clamp(int(dval), 0, 2047);
             } else if (mjson_get_string(post_buf, post_len, ss, buf, sizeof(buf))) {
-                config.len = std::clamp(int(atof(buf)), 0, 1023);
+                config.len = std::clamp(int(atof(buf)), 0, 2047);
             }
             
             sprintf(ss, "$.stripconfig[%d].color.r", c);
@@ -316,6 +332,75 @@ public:
                 config.color.x = std::clamp(int(strtol(buf, NULL, 10)), 0, 255);
             }
 
+            sprintf(ss, "$.stripconfig[%d].startchannel", c);
+            if (mjson_get_number(post_buf, post_len, ss, &dval) > 0) {
+                config.start_channel = std::clamp(int(dval), 1, 512);
+            } else if (mjson_get_string(post_buf, post_len, ss, buf, sizeof(buf)) > 0) {
+                config.start_channel = std::clamp(int(strtol(buf, NULL, 10)), 1, 512);
+            }
+
+            sprintf(ss, "$.stripconfig[%d].fpslimit", c);
+            if (mjson_get_number(post_buf, post_len, ss, &dval) > 0) {
+                config.fps_limit = std::clamp(int(dval), 0, 1000);
+            } else if (mjson_get_string(post_buf, post_len, ss, buf, sizeof(buf)) > 0) {
+                config.fps_limit = std::clamp(int(strtol(buf, NULL, 10)), 0, 1000);
+            }
+
+            sprintf(ss, "$.stripconfig[%d].interpolate", c);
+            if (mjson_get_bool(post_buf, post_len, ss, &ival) > 0) {
+                config.interpolate = ival ? 1 : 0;
+            }
+
+            sprintf(ss, "$.stripconfig[%d].continuous", c);
+            if (mjson_get_bool(post_buf, post_len, ss, &ival) > 0) {
+                config.continuous = ival ? 1 : 0;
+            }
+
+            sprintf(ss, "$.stripconfig[%d].map.width", c);
+            if (mjson_get_number(post_buf, post_len, ss, &dval) > 0) {
+                config.map.width = std::clamp(int(dval), 0, 1023);
+            } else if (mjson_get_string(post_buf, post_len, ss, buf, sizeof(buf)) > 0) {
+                config.map.width = std::clamp(int(strtol(buf, NULL, 10)), 0, 1023);
+            }
+
+            sprintf(ss, "$.stripconfig[%d].map.height", c);
+            if (mjson_get_number(post_buf, post_len, ss, &dval) > 0) {
+                config.map.height = std::clamp(int(dval), 0, 1023);
+            } else if (mjson_get_string(post_buf, post_len, ss, buf, sizeof(buf)) > 0) {
+                config.map.height = std::clamp(int(strtol(buf, NULL, 10)), 0, 1023);
+            }
+
+            sprintf(ss, "$.stripconfig[%d].map.offset", c);
+            if (mjson_get_number(post_buf, post_len, ss, &dval) > 0) {
+                config.map.offset = std::clamp(int(dval), 0, 1023);
+            } else if (mjson_get_string(post_buf, post_len, ss, buf, sizeof(buf)) > 0) {
+                config.map.offset = std::clamp(int(strtol(buf, NULL, 10)), 0, 1023);
+            }
+
+            sprintf(ss, "$.stripconfig[%d].map.gap", c);
+            if (mjson_get_number(post_buf, post_len, ss, &dval) > 0) {
+                config.map.gap = std::clamp(int(dval), 0, 1023);
+            } else if (mjson_get_string(post_buf, post_len, ss, buf, sizeof(buf)) > 0) {
+                config.map.gap = std::clamp(int(strtol(buf, NULL, 10)), 0, 1023);
+            }
+
+            sprintf(ss, "$.stripconfig[%d].map.group", c);
+            if (mjson_get_number(post_buf, post_len, ss, &dval) > 0) {
+                config.map.group = std::clamp(int(dval), 1, 255);
+            } else if (mjson_get_string(post_buf, post_len, ss, buf, sizeof(buf)) > 0) {
+                config.map.group = std::clamp(int(strtol(buf, NULL, 10)), 1, 255);
+            }
+
+            sprintf(ss, "$.stripconfig[%d].map.serpentine", c);
+            if (mjson_get_bool(post_buf, post_len, ss, &ival) > 0) {
+                config.map.serpentine = ival ? 1 : 0;
+            }
+
+            sprintf(ss, "$.stripconfig[%d].map.reverse", c);
+            if (mjson_get_bool(post_buf, post_len, ss, &ival) > 0) {
+                config.map.reverse = ival ? 1 : 0;
+            }
+
             sprintf(ss, "$.stripconfig[%d].rgbspace.xw", c);
             if (mjson_get_number(post_buf, post_len, ss, &dval) > 0) {
                 config.rgbSpace.xw = std::clamp(float(dval), -16.0f, +16.0f);
@@ -395,7 +480,6 @@ public:
 
         Model::instance().save();
         Systick::instance().scheduleApply();
-        sACNPacket::joinNetworks();
         Control::instance().setStartup();
     }
     
@@ -515,6 +599,41 @@ public:
         addString("\"systemtime\":%d", int(Systick::instance().systemTime())); 
     }
 
+    void addSyncSkew() {
+        handleDelimiter();
+        auto ns = [] (uint32_t cycles) { return int((uint64_t(cycles) * 1000000000) / uint64_t(SystemCoreClock)); };
+        addString("\"syncskew\":%d,\"syncskewmax\":%d", ns(Control::instance().syncSkew()), ns(Control::instance().syncSkewMax()));
+    }
+
+    void addStripRates() {
+        handleDelimiter();
+        addString("\"striprates\":["); 
+        for (size_t c=0; c<Model::stripN; c++) {
+            const Strip &s = Strip::get(c);
+            addString("{\"maxfps\":%d,\"infps\":%d,\"outfps\":%d,\"dropped\":%d}%c",
+                            int(s.maxRefreshRate()),
+                            int(s.inputRate()),
+                            int(s.outputRate()),
+                            int(s.droppedFrames()),
+                            (c==Model::stripN-1)?' ':',');
+        }
+        addString("]");
+    }
+
+    void addStripPower() {
+        handleDelimiter();
+        addString("\"powerbudget\":%s,", ftos(float(Strip::powerBudget()) * 0.001f));
+        addString("\"strippower\":["); 
+        for (size_t c=0; c<Model::stripN; c++) {
+            const Strip &s = Strip::get(c);
+            addString("{\"watts\":%s,", ftos(float(s.estimatedPower()) * 0.001f));
+            addString("\"scale\":%d}%c",
+                            int(s.powerScale() * 100 / 256),
+                            (c==Model::stripN-1)?' ':',');
+        }
+        addString("]");
+    }
+
     void addBuildNumber() {
         handleDelimiter();
         addString("\"buildnumber\":\"Rev %d (%s %s)\"", int(GIT_REV_COUNT), __DATE__, __TIME__); 
@@ -579,6 +698,26 @@ public:
         addString("\"outputconfig\":%d",int(Model::instance().outputConfig())); 
     }
 
+    void addFrameTimeout() {
+        handleDelimiter();
+        addString("\"frametimeout\":%d",int(Model::instance().frameTimeout())); 
+    }
+
+    void addRefreshInterval() {
+        handleDelimiter();
+        addString("\"refreshinterval\":%d",int(Model::instance().refreshInterval())); 
+    }
+
+    void addContentHash() {
+        handleDelimiter();
+        addString("\"contenthash\":%s",Model::instance().contentHash()?"true":"false"); 
+    }
+
+    void addPowerLimit() {
+        handleDelimiter();
+        addString("\"powerlimit\":%s",Model::instance().powerLimit()?"true":"false"); 
+    }
+
     void addAnalogConfig() {
         handleDelimiter();
         addString("\"rgbconfig\":["); 
@@ -630,6 +769,10 @@ public:
             addString("\"complimit\":%s,", ftos(s.comp_limit * 100.0f)); 
             addString("\"globillum\":%s,", ftos(s.glob_illum * 100.0f)); 
             addString("\"length\":%d,",int(s.len)); 
+            addString("\"startchannel\":%d,",int(s.start_channel)); 
+            addString("\"continuous\":%s,",s.continuous ? "true" : "false"); 
+            addString("\"fpslimit\":%d,",int(s.fps_limit)); 
+            addString("\"interpolate\":%s,",s.interpolate ? "true" : "false"); 
             addString("\"rgbspace\":{");
             addString("\"xw\":%s,",ftos(s.rgbSpace.xw)); 
             addString("\"yw\":%s,",ftos(s.rgbSpace.yw)); 
@@ -645,6 +788,14 @@ public:
                             int(s.color.g),
                             int(s.color.b),
                             int(s.color.x)); 
+            addString("\"map\":{\"width\":%d,\"height\":%d,\"offset\":%d,\"gap\":%d,\"group\":%d,\"serpentine\":%s,\"reverse\":%s},",
+                            int(s.map.width),
+                            int(s.map.height),
+                            int(s.map.offset),
+                            int(s.map.gap),
+                            std::max(int(s.map.group), 1),
+                            s.map.serpentine ? "true" : "false",
+                            s.map.reverse ? "true" : "false"); 
             addString("\"universes\":[");
             for (size_t d=0; d<Model::universeN; d++) {
                 addString("{");
@@ -863,6 +1014,9 @@ err_t httpd_rest_finished(void *handle, const char **data, u16_t *dataLen) {
             response.addNetConfIPv4Netmask();
             response.addNetConfIPv4Gateway();
             response.addSystemTime();
+            response.addSyncSkew();
+            response.addStripRates();
+            response.addStripPower();
             response.addBuildNumber();
             response.addHostname();
             response.addMacAddress();
@@ -883,6 +1037,10 @@ err_t httpd_rest_finished(void *handle, const char **data, u16_t *dataLen) {
             response.addIPv4Netmask();
             response.addIPv4Gateway();
             response.addOutputConfig();
+            response.addFrameTimeout();
+            response.addRefreshInterval();
+            response.addContentHash();
+            response.addPowerLimit();
             response.addAnalogConfig();
             response.addStripConfig();
             *data = response.finish(*dataLen);
@@ -36,19 +36,27 @@ extern "C" {
 
 __attribute__((used))
 void DMA0_Channel2_IRQHandler() {
+    if(dma_interrupt_flag_get(DMA0, DMA_CH2, DMA_INT_FLAG_HTF)) {
+        dma_interrupt_flag_clear(DMA0, DMA_CH2, DMA_INT_FLAG_HTF);
+        lightkraken::SPI_0::instance().dmaHalfDone();
+    }
     if(dma_interrupt_flag_get(DMA0, DMA_CH2, DMA_INT_FLAG_FTF)) {
         dma_interrupt_flag_clear(DMA0, DMA_CH2, DMA_INT_FLAG_FTF);
         dma_interrupt_flag_clear(DMA0, DMA_CH2, DMA_INT_FLAG_G);
-        lightkraken::SPI_0::instance().setActive(false);
+        lightkraken::SPI_0::instance().dmaDone();
     }
 }
 
 __attribute__((used))
 void DMA1_Channel1_IRQHandler() {
+    if(dma_interrupt_flag_get(DMA1, DMA_CH1, DMA_INT_FLAG_HTF)) {
+        dma_interrupt_flag_clear(DMA1, DMA_CH1, DMA_INT_FLAG_HTF);
+        lightkraken::SPI_2::instance().dmaHalfDone();
+    }
     if(dma_interrupt_flag_get(DMA1, DMA_CH1, DMA_INT_FLAG_FTF)){
         dma_interrupt_flag_clear(DMA1, DMA_CH1, DMA_INT_FLAG_FTF);
         dma_interrupt_flag_clear(DMA1, DMA_CH1, DMA_INT_FLAG_G);
-        lightkraken::SPI_2::instance().setActive(false);
+        lightkraken::SPI_2::instance().dmaDone();
     }
 }
 
@@ -60,6 +68,87 @@ void PendSV_Handler(void) {
 
 namespace lightkraken {
 
+// If a transfer is still running the new buffer is queued, replacing any
+// previously queued one, and started from the DMA completion interrupt.
+// Callers may have interrupts off to start several outputs back to back,
+// so the interrupt state is restored rather than enabled.
+void SPI::transfer(const uint8_t *buf, size_t len, bool wantsSCLK) {
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (active && busy()) {
+        qbuf = buf;
+        qlen = len;
+        qsclk = wantsSCLK;
+        __set_PRIMASK(primask);
+        return;
+    }
+    qbuf = 0;
+    source = 0;
+    start(buf, len, wantsSCLK);
+    __set_PRIMASK(primask);
+}
+
+// Sends the ring over and over in circular DMA mode. Each time the DMA is done
+// with one half of the ring the source refills it, until it reports that the
+// frame is complete. Both halves have to be filled before calling this.
+void SPI::stream(uint8_t *buf, size_t len, bool wantsSCLK, Source *src) {
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (active && busy()) {
+        __set_PRIMASK(primask);
+        return;
+    }
+    qbuf = 0;
+    ring = buf;
+    source = src;
+    start(buf, len, wantsSCLK);
+    __set_PRIMASK(primask);
+}
+
+void SPI::update() {
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (qbuf && !(active && busy())) {
+        const uint8_t *buf = qbuf;
+        qbuf = 0;
+        start(buf, qlen, qsclk);
+    }
+    __set_PRIMASK(primask);
+}
+
+bool SPI::cancelQueued() {
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool queued = qbuf != 0;
+    qbuf = 0;
+    __set_PRIMASK(primask);
+    return queued;
+}
+
+void SPI::dmaHalfDone() {
+    if (source && !source->fill(ring, clen / 2)) {
+        stop();
+        source = 0;
+        dmaDone();
+    }
+}
+
+void SPI::dmaDone() {
+    if (source) {
+        if (source->fill(ring + clen / 2, clen / 2)) {
+            return;
+        }
+        stop();
+        source = 0;
+    }
+    active = false;
+    if (qbuf) {
+        const uint8_t *buf = qbuf;
+        qbuf = 0;
+        start(buf, qlen, qsclk);
+    }
+}
+
 SPI_0 &SPI_0::instance() {
     static SPI_0 spi0;
     if (!spi0.initialized) {
@@ -77,37 +166,39 @@ bool SPI_0::busy() const {
     return false;
 }
 
-void SPI_0::transfer(const uint8_t *buf, size_t len, bool wantsSCLK) {
+uint32_t SPI_0::busClock() const {
+    return rcu_clock_freq_get(CK_APB2);
+}
+
+void SPI_0::start(const uint8_t *buf, size_t len, bool wantsSCLK) {
     gpio_init(GPIOA, GPIO_MODE_OUT_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_10);
     gpio_bit_set(GPIOA, GPIO_PIN_10);
 
-    if (active) {
-        if (busy()) {
-            scheduled = true;
-            return;
-        }
-    }
-
     dma_channel_disable(DMA0, DMA_CH2);
     active = false;
+    // A completion of the previous transfer still pending would otherwise
+    // end this one as soon as interrupts are back on
+    dma_interrupt_flag_clear(DMA0, DMA_CH2, DMA_INT_FLAG_G);
+    NVIC_ClearPendingIRQ(DMA0_Channel2_IRQn);
 
-    if (changed || cbuf != buf || clen != len || wantsSCLK != sclk) {
+    if (changed || cbuf != buf || clen != len || wantsSCLK != sclk || circular != (source != 0)) {
         changed = false;
         cbuf = buf;
         clen = len;
         sclk = wantsSCLK;
+        circular = source != 0;
         dma_setup();
+    } else {
+        dma_transfer_number_config(DMA0, DMA_CH2, clen);
     }
 
     dma_channel_enable(DMA0, DMA_CH2);
     active = true;
 }
 
-void SPI_0::update() {
-    if (scheduled) {
-        scheduled = false;
-        transfer(cbuf, clen, sclk);
-    }
+void SPI_0::stop() {
+    dma_channel_disable(DMA0, DMA_CH2);
+    dma_interrupt_flag_clear(DMA0, DMA_CH2, DMA_INT_FLAG_G);
 }
 
 void SPI_0::dma_setup() {
@@ -127,7 +218,7 @@ void SPI_0::dma_setup() {
     spi_init_struct.frame_size           = SPI_FRAMESIZE_8BIT;
     spi_init_struct.clock_polarity_phase = SPI_CK_PL_LOW_PH_1EDGE;
     spi_init_struct.nss                  = SPI_NSS_SOFT;
-    spi_init_struct.prescale             = fast ? SPI_PSC_32 : SPI_PSC_64;
+    spi_init_struct.prescale             = CTL0_PSC(psc);
     spi_init_struct.endian               = SPI_ENDIAN_MSB;
     spi_init(SPI0, &spi_init_struct);
     
@@ -146,7 +237,13 @@ void SPI_0::dma_setup() {
     dma_init_struct.periph_inc   = DMA_PERIPH_INCREASE_DISABLE;
     dma_init_struct.memory_inc   = DMA_MEMORY_INCREASE_ENABLE;
     dma_init(DMA0, DMA_CH2, &dma_init_struct);
-    dma_circulation_disable(DMA0, DMA_CH2);
+    if (circular) {
+        dma_circulation_enable(DMA0, DMA_CH2);
+        dma_interrupt_enable(DMA0, DMA_CH2, DMA_INT_HTF);
+    } else {
+        dma_circulation_disable(DMA0, DMA_CH2);
+        dma_interrupt_disable(DMA0, DMA_CH2, DMA_INT_HTF);
+    }
     dma_memory_to_memory_disable(DMA0, DMA_CH2);
     
     dma_interrupt_enable(DMA0, DMA_CH2, DMA_INT_FTF);
@@ -182,38 +279,39 @@ bool SPI_2::busy() const {
     return false;
 }
 
-void SPI_2::transfer(const uint8_t *buf, size_t len, bool wantsSCLK) {
+uint32_t SPI_2::busClock() const {
+    return rcu_clock_freq_get(CK_APB1);
+}
+
+void SPI_2::start(const uint8_t *buf, size_t len, bool wantsSCLK) {
     gpio_init(GPIOB, GPIO_MODE_OUT_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_9);
     gpio_bit_set(GPIOB, GPIO_PIN_9);
 
-    if (active) {
-        if(busy()) {
-            scheduled = true;
-            return;
-        }
-    }
-    
     dma_channel_disable(DMA1, DMA_CH1);
     active = false;
+    // A completion of the previous transfer still pending would otherwise
+    // end this one as soon as interrupts are back on
+    dma_interrupt_flag_clear(DMA1, DMA_CH1, DMA_INT_FLAG_G);
+    NVIC_ClearPendingIRQ(DMA1_Channel1_IRQn);
 
-    if (changed || cbuf != buf || clen != len || wantsSCLK != sclk) {
+    if (changed || cbuf != buf || clen != len || wantsSCLK != sclk || circular != (source != 0)) {
         changed = false;
         cbuf = buf;
         clen = len;
         sclk = wantsSCLK;
+        circular = source != 0;
         dma_setup();
+    } else {
+        dma_transfer_number_config(DMA1, DMA_CH1, clen);
     }
 
     dma_channel_enable(DMA1, DMA_CH1);
     active = true;
-
 }
 
-void SPI_2::update() {
-    if (scheduled) {
-        scheduled = false;
-        transfer(cbuf, clen, sclk);
-    }
+void SPI_2::stop() {
+    dma_channel_disable(DMA1, DMA_CH1);
+    dma_interrupt_flag_clear(DMA1, DMA_CH1, DMA_INT_FLAG_G);
 }
 
 void SPI_2::dma_setup() {
@@ -233,7 +331,7 @@ void SPI_2::dma_setup() {
     spi_init_struct.frame_size           = SPI_FRAMESIZE_8BIT;
     spi_init_struct.clock_polarity_phase = SPI_CK_PL_LOW_PH_1EDGE;
     spi_init_struct.nss                  = SPI_NSS_SOFT;
-    spi_init_struct.prescale             = fast ? SPI_PSC_16 : SPI_PSC_32;
+    spi_init_struct.prescale             = CTL0_PSC(psc);
     spi_init_struct.endian               = SPI_ENDIAN_MSB;
     spi_init(SPI2, &spi_init_struct);
     
@@ -252,7 +350,13 @@ void SPI_2::dma_setup() {
     dma_init_struct.periph_inc   = DMA_PERIPH_INCREASE_DISABLE;
     dma_init_struct.memory_inc   = DMA_MEMORY_INCREASE_ENABLE;
     dma_init(DMA1, DMA_CH1, &dma_init_struct);
-    dma_circulation_disable(DMA1, DMA_CH1);
+    if (circular) {
+        dma_circulation_enable(DMA1, DMA_CH1);
+        dma_interrupt_enable(DMA1, DMA_CH1, DMA_INT_HTF);
+    } else {
+        dma_circulation_disable(DMA1, DMA_CH1);
+        dma_interrupt_disable(DMA1, DMA_CH1, DMA_INT_HTF);
+    }
     dma_memory_to_memory_disable(DMA1, DMA_CH1);
 
     dma_interrupt_enable(DMA1, DMA_CH1, DMA_INT_FTF);
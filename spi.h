@@ -23,36 +23,68 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef SPI_H
 #define SPI_H
 
+#include <stdint.h>
+#include <stddef.h>
+
 namespace lightkraken {
 
 class SPI {
 public:
 
-    void setFast(bool state) { if (fast != state) { fast = state; changed = true; } }
-    void setActive(bool state) { active = state; }
-    
+    // Refills a ring running in circular DMA mode, see stream()
+    class Source {
+    public:
+        // Fill the half of the ring the DMA just finished with, return
+        // false once the whole frame has been sent out.
+        virtual bool fill(uint8_t *dst, size_t len) = 0;
+    };
+
+    void transfer(const uint8_t *buf, size_t len, bool wantsSCLK);
+    void stream(uint8_t *ring, size_t len, bool wantsSCLK, Source *source);
+    void update();
+    virtual bool busy() const = 0;
+    virtual uint32_t busClock() const = 0;
+
+    // Buffer the DMA is currently reading from, 0 if idle
+    const uint8_t *inFlight() const { return active ? cbuf : 0; }
+    bool cancelQueued();
+
+    // SPI clock is busClock() / (2 << shift)
+    void setPrescaler(uint32_t shift) { if (psc != shift) { psc = shift; changed = true; } }
+    void dmaDone();
+    void dmaHalfDone();
+
 protected:
 
-    bool active = false;
+    virtual void start(const uint8_t *buf, size_t len, bool wantsSCLK) = 0;
+    virtual void stop() = 0;
+
+    volatile bool active = false;
     bool initialized = false;
     const uint8_t *cbuf = 0;
     bool sclk = false;
     size_t clen = 0;
-    bool scheduled = false;
-    bool fast = true;
+    const uint8_t *qbuf = 0;
+    size_t qlen = 0;
+    bool qsclk = false;
+    uint32_t psc = 4;
     bool changed = false;
+    bool circular = false;
+    uint8_t *ring = 0;
+    Source *source = 0;
 };
 
 class SPI_0 : public SPI {
 public:
     static SPI_0 &instance();
 
-    void transfer(const uint8_t *buf, size_t len, bool wantsSCLK);
-    void update();
-    bool busy() const;
+    virtual bool busy() const;
+    virtual uint32_t busClock() const;
     
 private:
 
+    virtual void start(const uint8_t *buf, size_t len, bool wantsSCLK);
+    virtual void stop();
     void init();
     void dma_setup();
 };
@@ -61,11 +93,13 @@ class SPI_2 : public SPI {
 public:
     static SPI_2 &instance();
 
-    void transfer(const uint8_t *buf, size_t len, bool wantsSCLK);
-    void update();
-    bool busy() const;
+    virtual bool busy() const;
+    virtual uint32_t busClock() const;
+
 private:
 
+    virtual void start(const uint8_t *buf, size_t len, bool wantsSCLK);
+    virtual void stop();
     void init();
     void dma_setup();
 };
@@ -63,6 +63,25 @@ void StatusLED::readPowerState() {
     tph_state = gpio_input_bit_get(GPIOA, GPIO_PIN_4) == RESET ? false : true;
     powergood_state = gpio_input_bit_get(GPIOB, GPIO_PIN_0) == RESET ? false : true;
 }
+
+// Power the PD may draw in the negotiated class, in mW, or 0 if there is
+// no valid class. Class 5-6 and 7-8 can't be told apart, so it is the lower.
+uint32_t StatusLED::classPower() const {
+    switch(power_class) {
+        case PSE_TYPE_1_2_CLASS_0_3:
+        case PSE_TYPE_3_4_CLASS_0_3:
+            return 12950;
+        case PSE_TYPE_2_CLASS_4:
+        case PSE_TYPE_3_4_CLASS_4:
+            return 25500;
+        case PSE_TYPE_3_4_CLASS_5_6:
+            return 40000;
+        case PSE_TYPE_4_CLASS_7_8:
+            return 62000;
+        default:
+            return 0;
+    }
+}
 #endif  // #ifndef BOOTLOADER
 
 void StatusLED::schedule() {
@@ -49,6 +49,7 @@ public:
     };
     
     PowerClass powerClass() { readPowerState(); return power_class; }
+    uint32_t classPower() const;
     
     void setEnetUp() { enet_up = true; }
     bool enetUp() const { return enet_up; }
@@ -23,7 +23,7 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <stdint.h>
 #include <string.h>
 #include <algorithm>
-#include <vector>
+#include <utility>
 #include <cmath>
 
 #include "./main.h"
@@ -31,6 +31,13 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "./model.h"
 #include "./color.h"
 #include "./perf.h"
+#include "./systick.h"
+
+extern "C" uint32_t SystemCoreClock;
+#ifdef STRIP_BENCHMARK
+extern "C" uint8_t _sramfunc[];
+extern "C" uint8_t _eramfunc[];
+#endif  // #ifdef STRIP_BENCHMARK
 
 #define __assume(cond) do { if (!(cond)) __builtin_unreachable(); } while (0)
 
@@ -43,53 +50,24 @@ static constexpr std::array<uint16_t, ws2816b_error_extent_n> make_ws2816b_error
     return lut;
 };
 
-namespace lightkraken { 
-
-    static ColorSpaceConverter converter;
-
-    class manchester_bit_buf {
-    public:
-            manchester_bit_buf(uint8_t *p) {
-                buf = p;
-                byte = 0;
-                bit_pos = 7;
-                byte_pos = 0;
-                man_pos = 0;
-            }
+// Manchester code of a byte, MSB first: a one is sent as 10, a zero as 01
+static constexpr std::array<uint16_t, 256> make_manchester_lut() {
+    std::array<uint16_t, 256> lut = { 0 };
+    for (size_t c = 0; c < lut.size(); c++) {
+        uint16_t code = 0;
+        for (int32_t b = 7; b >= 0; b--) {
+            code = uint16_t((code << 2) | (((c >> b) & 1) ? 0b10 : 0b01));
+        }
+        lut[c] = code;
+    }
+    return lut;
+};
 
-            __attribute__ ((hot, optimize("O2")))
-            void push(uint32_t bits, int32_t count) {
-                for (int32_t c = 0; c < count; c++) {
-                    for (int32_t d = 0; d < 2; d++) {
-                        byte |= ((man_pos & 1) ^ ((bits & (1UL<<31)) ? 1 : 0)) ? (1UL<<bit_pos) : 0;
-                        bit_pos--;
-                        if (bit_pos < 0) {
-                            buf[byte_pos++] = byte;
-                            byte = 0;
-                            bit_pos = 7;
-                        }
-                        man_pos++;
-                    }
-                    bits <<= 1;
-                }
-            }
+static constexpr std::array<uint16_t, 256> manchester_lut = make_manchester_lut();
 
-            void flush() {
-                buf[byte_pos++] = byte;
-                byte = 0;
-                bit_pos = 7;
-            }
+namespace lightkraken { 
 
-            size_t len() {
-                return byte_pos;
-            }
-    private:
-        uint8_t *buf;
-        uint8_t  byte;
-        int32_t     byte_pos;
-        int32_t  bit_pos;
-        int32_t  man_pos;
-    };
+    static ColorSpaceConverter converter;
 
     Strip &Strip::get(size_t index) {
         static Strip strips[lightkraken::Model::stripN];
@@ -103,128 +81,245 @@ namespace lightkraken {
         return strips[index % lightkraken::Model::stripN];
     }
 
-    bool Strip::ws2812_lut_init = false;
-    std::array<uint32_t, 256> Strip::ws2812_lut;
-    bool Strip::hd108_lut_init = false;
-    std::array<std::array<uint16_t, 256>, 3> Strip::hd108_lut;
+    uint32_t Strip::power_budget = 0;
+
+    // Gamma and per channel response of the HD108, looked up for every
+    // component, so it lives in RAM. Generated offline with t = d / 255:
+    //   R = pow(t, 2.4)
+    //   G = pow(log((t + 1 / a) * a) * -1 / k, 2.4), a = exp(-k) - 1, k = 0.760
+    //   B = same as G with k = 0.550
+    // each scaled by 65535 and truncated.
+    RAMDATA const std::array<std::array<uint16_t, 256>, 3> Strip::hd108_lut = {{
+    // R
+    {{
+        0x0000, 0x0000, 0x0000, 0x0001, 0x0003, 0x0005, 0x0008, 0x000b, 0x0010, 0x0015, 0x001b, 0x0022,
+        0x002a, 0x0033, 0x003d, 0x0049, 0x0055, 0x0062, 0x0071, 0x0080, 0x0091, 0x00a3, 0x00b7, 0x00cb,
+        0x00e1, 0x00f8, 0x0111, 0x012b, 0x0146, 0x0163, 0x0181, 0x01a0, 0x01c1, 0x01e4, 0x0208, 0x022d,
+        0x0254, 0x027d, 0x02a7, 0x02d3, 0x0300, 0x032f, 0x0360, 0x0392, 0x03c6, 0x03fb, 0x0432, 0x046b,
+        0x04a6, 0x04e2, 0x0521, 0x0561, 0x05a2, 0x05e6, 0x062b, 0x0672, 0x06bb, 0x0706, 0x0753, 0x07a1,
+        0x07f1, 0x0844, 0x0898, 0x08ee, 0x0946, 0x09a0, 0x09fc, 0x0a5a, 0x0aba, 0x0b1c, 0x0b80, 0x0be6,
+        0x0c4e, 0x0cb8, 0x0d24, 0x0d92, 0x0e02, 0x0e75, 0x0ee9, 0x0f60, 0x0fd8, 0x1053, 0x10d0, 0x114f,
+        0x11d0, 0x1254, 0x12d9, 0x1361, 0x13eb, 0x1477, 0x1506, 0x1596, 0x1629, 0x16be, 0x1756, 0x17ef,
+        0x188b, 0x192a, 0x19ca, 0x1a6d, 0x1b12, 0x1bba, 0x1c64, 0x1d10, 0x1dbe, 0x1e6f, 0x1f22, 0x1fd8,
+        0x2090, 0x214b, 0x2208, 0x22c7, 0x2389, 0x244d, 0x2513, 0x25dc, 0x26a8, 0x2776, 0x2846, 0x2919,
+        0x29ef, 0x2ac7, 0x2ba1, 0x2c7e, 0x2d5e, 0x2e40, 0x2f24, 0x300c, 0x30f5, 0x31e2, 0x32d0, 0x33c2,
+        0x34b6, 0x35ad, 0x36a6, 0x37a2, 0x38a0, 0x39a1, 0x3aa5, 0x3bac, 0x3cb5, 0x3dc0, 0x3ecf, 0x3fe0,
+        0x40f4, 0x420a, 0x4323, 0x443f, 0x455e, 0x467f, 0x47a3, 0x48ca, 0x49f4, 0x4b20, 0x4c4f, 0x4d81,
+        0x4eb6, 0x4fed, 0x5127, 0x5264, 0x53a4, 0x54e6, 0x562c, 0x5774, 0x58bf, 0x5a0d, 0x5b5e, 0x5cb1,
+        0x5e08, 0x5f61, 0x60bd, 0x621c, 0x637e, 0x64e3, 0x664b, 0x67b6, 0x6923, 0x6a94, 0x6c07, 0x6d7e,
+        0x6ef7, 0x7073, 0x71f2, 0x7374, 0x74fa, 0x7682, 0x780d, 0x799b, 0x7b2c, 0x7cc0, 0x7e57, 0x7ff1,
+        0x818e, 0x832e, 0x84d1, 0x8677, 0x8821, 0x89cd, 0x8b7c, 0x8d2f, 0x8ee4, 0x909c, 0x9258, 0x9417,
+        0x95d8, 0x979d, 0x9965, 0x9b30, 0x9cff, 0x9ed0, 0xa0a4, 0xa27c, 0xa457, 0xa634, 0xa815, 0xa9fa,
+        0xabe1, 0xadcb, 0xafb9, 0xb1aa, 0xb39e, 0xb595, 0xb790, 0xb98d, 0xbb8e, 0xbd92, 0xbf99, 0xc1a4,
+        0xc3b2, 0xc5c2, 0xc7d7, 0xc9ee, 0xcc09, 0xce27, 0xd048, 0xd26d, 0xd494, 0xd6bf, 0xd8ee, 0xdb1f,
+        0xdd54, 0xdf8d, 0xe1c8, 0xe407, 0xe649, 0xe88f, 0xead8, 0xed24, 0xef74, 0xf1c6, 0xf41d, 0xf676,
+        0xf8d3, 0xfb34, 0xfd97, 0xffff,
+    }},
+    // G
+    {{
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0001, 0x0002, 0x0003, 0x0005, 0x0007, 0x0009, 0x000c, 0x000f,
+        0x0012, 0x0016, 0x001b, 0x0020, 0x0025, 0x002b, 0x0032, 0x0039, 0x0041, 0x0049, 0x0052, 0x005b,
+        0x0066, 0x0070, 0x007c, 0x0088, 0x0095, 0x00a2, 0x00b1, 0x00c0, 0x00cf, 0x00e0, 0x00f1, 0x0103,
+        0x0116, 0x012a, 0x013f, 0x0154, 0x016a, 0x0182, 0x019a, 0x01b3, 0x01cd, 0x01e7, 0x0203, 0x0220,
+        0x023e, 0x025d, 0x027c, 0x029d, 0x02bf, 0x02e2, 0x0306, 0x032b, 0x0352, 0x0379, 0x03a1, 0x03cb,
+        0x03f6, 0x0422, 0x044f, 0x047e, 0x04ad, 0x04de, 0x0510, 0x0544, 0x0579, 0x05af, 0x05e6, 0x061f,
+        0x0659, 0x0695, 0x06d2, 0x0710, 0x0750, 0x0791, 0x07d4, 0x0818, 0x085e, 0x08a5, 0x08ee, 0x0938,
+        0x0984, 0x09d2, 0x0a21, 0x0a72, 0x0ac4, 0x0b19, 0x0b6f, 0x0bc6, 0x0c20, 0x0c7b, 0x0cd8, 0x0d36,
+        0x0d97, 0x0df9, 0x0e5e, 0x0ec4, 0x0f2c, 0x0f96, 0x1002, 0x1070, 0x10e0, 0x1152, 0x11c6, 0x123c,
+        0x12b4, 0x132e, 0x13ab, 0x1429, 0x14aa, 0x152d, 0x15b2, 0x163a, 0x16c4, 0x1750, 0x17de, 0x186f,
+        0x1902, 0x1998, 0x1a30, 0x1acb, 0x1b68, 0x1c07, 0x1ca9, 0x1d4e, 0x1df6, 0x1ea0, 0x1f4c, 0x1ffc,
+        0x20ae, 0x2163, 0x221a, 0x22d5, 0x2392, 0x2452, 0x2516, 0x25dc, 0x26a5, 0x2771, 0x2840, 0x2912,
+        0x29e8, 0x2ac0, 0x2b9c, 0x2c7b, 0x2d5d, 0x2e43, 0x2f2b, 0x3018, 0x3107, 0x31fa, 0x32f1, 0x33eb,
+        0x34e8, 0x35ea, 0x36ef, 0x37f7, 0x3903, 0x3a13, 0x3b27, 0x3c3f, 0x3d5a, 0x3e7a, 0x3f9d, 0x40c5,
+        0x41f0, 0x4320, 0x4454, 0x458c, 0x46c8, 0x4809, 0x494e, 0x4a97, 0x4be5, 0x4d37, 0x4e8e, 0x4fea,
+        0x514a, 0x52ae, 0x5418, 0x5586, 0x56fa, 0x5872, 0x59ef, 0x5b71, 0x5cf9, 0x5e85, 0x6017, 0x61ae,
+        0x634a, 0x64ec, 0x6693, 0x683f, 0x69f2, 0x6baa, 0x6d67, 0x6f2b, 0x70f4, 0x72c3, 0x7498, 0x7673,
+        0x7855, 0x7a3c, 0x7c2a, 0x7e1e, 0x8019, 0x821a, 0x8422, 0x8630, 0x8845, 0x8a61, 0x8c84, 0x8eae,
+        0x90df, 0x9317, 0x9556, 0x979d, 0x99eb, 0x9c41, 0x9e9e, 0xa103, 0xa36f, 0xa5e4, 0xa861, 0xaae5,
+        0xad72, 0xb007, 0xb2a5, 0xb54b, 0xb7f9, 0xbab1, 0xbd71, 0xc03a, 0xc30c, 0xc5e7, 0xc8cc, 0xcbba,
+        0xceb1, 0xd1b2, 0xd4bd, 0xd7d2, 0xdaf1, 0xde19, 0xe14d, 0xe48a, 0xe7d2, 0xeb25, 0xee83, 0xf1eb,
+        0xf55f, 0xf8de, 0xfc69, 0xffff,
+    }},
+    // B
+    {{
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0001, 0x0002, 0x0004, 0x0006, 0x0008, 0x000b, 0x000e, 0x0012,
+        0x0017, 0x001c, 0x0021, 0x0028, 0x002e, 0x0036, 0x003e, 0x0047, 0x0050, 0x005a, 0x0065, 0x0071,
+        0x007e, 0x008b, 0x0099, 0x00a8, 0x00b8, 0x00c8, 0x00da, 0x00ec, 0x00ff, 0x0113, 0x0129, 0x013f,
+        0x0156, 0x016e, 0x0187, 0x01a1, 0x01bc, 0x01d8, 0x01f5, 0x0213, 0x0233, 0x0253, 0x0275, 0x0298,
+        0x02bc, 0x02e1, 0x0307, 0x032e, 0x0357, 0x0381, 0x03ac, 0x03d9, 0x0407, 0x0436, 0x0466, 0x0498,
+        0x04cb, 0x04ff, 0x0535, 0x056c, 0x05a5, 0x05df, 0x061b, 0x0658, 0x0696, 0x06d6, 0x0718, 0x075b,
+        0x079f, 0x07e5, 0x082d, 0x0877, 0x08c2, 0x090e, 0x095c, 0x09ac, 0x09fe, 0x0a51, 0x0aa6, 0x0afd,
+        0x0b56, 0x0bb0, 0x0c0c, 0x0c6a, 0x0cca, 0x0d2c, 0x0d8f, 0x0df5, 0x0e5c, 0x0ec5, 0x0f31, 0x0f9e,
+        0x100d, 0x107e, 0x10f2, 0x1167, 0x11de, 0x1258, 0x12d3, 0x1351, 0x13d1, 0x1453, 0x14d7, 0x155d,
+        0x15e6, 0x1671, 0x16fe, 0x178d, 0x181f, 0x18b3, 0x1949, 0x19e2, 0x1a7d, 0x1b1b, 0x1bbb, 0x1c5e,
+        0x1d03, 0x1daa, 0x1e55, 0x1f01, 0x1fb1, 0x2062, 0x2117, 0x21ce, 0x2288, 0x2345, 0x2404, 0x24c6,
+        0x258b, 0x2653, 0x271d, 0x27ea, 0x28bb, 0x298e, 0x2a64, 0x2b3d, 0x2c19, 0x2cf8, 0x2dda, 0x2ebf,
+        0x2fa7, 0x3093, 0x3181, 0x3273, 0x3368, 0x3460, 0x355b, 0x365a, 0x375c, 0x3861, 0x396a, 0x3a76,
+        0x3b86, 0x3c99, 0x3daf, 0x3eca, 0x3fe7, 0x4108, 0x422d, 0x4356, 0x4482, 0x45b2, 0x46e6, 0x481d,
+        0x4959, 0x4a98, 0x4bdb, 0x4d22, 0x4e6d, 0x4fbc, 0x510f, 0x5266, 0x53c1, 0x5520, 0x5684, 0x57eb,
+        0x5957, 0x5ac8, 0x5c3c, 0x5db5, 0x5f32, 0x60b4, 0x623a, 0x63c5, 0x6554, 0x66e8, 0x6880, 0x6a1e,
+        0x6bbf, 0x6d66, 0x6f11, 0x70c2, 0x7277, 0x7431, 0x75f0, 0x77b4, 0x797d, 0x7b4b, 0x7d1f, 0x7ef7,
+        0x80d5, 0x82b8, 0x84a1, 0x868f, 0x8882, 0x8a7b, 0x8c79, 0x8e7d, 0x9086, 0x9295, 0x94aa, 0x96c5,
+        0x98e5, 0x9b0c, 0x9d38, 0x9f6a, 0xa1a2, 0xa3e1, 0xa625, 0xa870, 0xaac1, 0xad19, 0xaf76, 0xb1da,
+        0xb445, 0xb6b6, 0xb92e, 0xbbac, 0xbe32, 0xc0be, 0xc350, 0xc5ea, 0xc88b, 0xcb33, 0xcde1, 0xd098,
+        0xd355, 0xd619, 0xd8e5, 0xdbb9, 0xde93, 0xe176, 0xe460, 0xe752, 0xea4b, 0xed4d, 0xf056, 0xf368,
+        0xf681, 0xf9a3, 0xfccc, 0xffff,
+    }}
+    }};
 
     void Strip::init() {
         comp_buf.fill(0);
         spi_buf.fill(0);
         transfer_flag = false;
+        updateCopyKernel();
+        updateWireLayout();
         RGBColorSpace rgbSpace;
         rgbSpace.setsRGB();
         converter.setRGBColorSpace(rgbSpace);
-        if (!ws2812_lut_init) {
-            ws2812_lut_init = true;
-            auto make_ws2812_table = [] () constexpr -> std::array<uint32_t, 256> {
-                std::array<uint32_t, 256> table = { 0 };
-                for (uint32_t c = 0; c < 256; c++) {
-                    table[c] = 0x88888888 |
-                            (((c >>  4) | (c <<  6) | (c << 16) | (c << 26)) & 0x04040404)|
-                            (((c >>  1) | (c <<  9) | (c << 19) | (c << 29)) & 0x40404040);
-                }
-                return table;
-            };
-            // Make a RAM copy; gets us a slight perf improvement
-            ws2812_lut = make_ws2812_table();
-        }
-        if (!hd108_lut_init) {
-            hd108_lut_init = true;
-            auto make_hd108_table = [] () constexpr -> std::array<std::array<uint16_t, 256>, 3> {
-                std::array<std::array<uint16_t, 256>, 3> lut {};
-                double r_const = 1.000;
-                double g_const = 0.760;
-                double b_const = 0.550;
-
-                double ga_const =  exp(-g_const) - 1.0;
-                double gai_const = + 1.0 / ga_const;
-                double gbi_const = - 1.0 / g_const;
-
-                double ba_const =  exp(-b_const) - 1.0;
-                double bai_const = + 1.0 / ba_const;
-                double bbi_const = - 1.0 / b_const;
-
-                for (size_t d = 0; d < 256; d++) {
-                    double t = double(d) / 255.0;
-                    // R
-                    lut[0][d] =  uint16_t(pow(t * r_const, 2.4) * 65535.0);
-                    // G
-                    lut[1][d] =  uint16_t(pow((log((t + gai_const) * ga_const) * gbi_const), 2.4) * 65535.0);
-                    // B
-                    lut[2][d] =  uint16_t(pow((log((t + bai_const) * ba_const) * bbi_const), 2.4) * 65535.0);
-                }
-                return lut;
-            };
-            // Make a RAM copy; gets us a slight perf improvement
-            hd108_lut = make_hd108_table();
-        }
     }
 
     void Strip::setRGBColorSpace(const RGBColorSpace &colorSpace) {
         converter.setRGBColorSpace(colorSpace);
     }
     
-    size_t Strip::getBytesPerPixel() const {
-        switch(output_type) {
-            case SK6812_RGBW: {
+    // Pixel format traits. These are constexpr so the copy kernels below can
+    // be specialized for every input/output combination at compile time.
+
+    static constexpr size_t inputPixelBytes(Strip::InputType input_type) {
+        switch (input_type) {
+            default:
+            case Strip::INPUT_sRGB8:
+            case Strip::INPUT_dRGB8: {
+                return 3;
+            } break;
+            case Strip::INPUT_sRGBW8:
+            case Strip::INPUT_dRGBW8: {
                 return 4;
             } break;
+            case Strip::INPUT_dRGB16LSB:
+            case Strip::INPUT_dRGB16MSB: {
+                return 6;
+            } break;
+            case Strip::INPUT_dRGBW16LSB:
+            case Strip::INPUT_dRGBW16MSB: {
+                return 8;
+            } break;
+        }
+    }
+
+    static constexpr bool inputHasWhite(Strip::InputType input_type) {
+        return inputPixelBytes(input_type) == 4 || inputPixelBytes(input_type) == 8;
+    }
+
+    static constexpr bool inputIs16Bit(Strip::InputType input_type) {
+        return inputPixelBytes(input_type) >= 6;
+    }
+
+    static constexpr bool inputIsLSB(Strip::InputType input_type) {
+        return input_type == Strip::INPUT_dRGB16LSB || input_type == Strip::INPUT_dRGBW16LSB;
+    }
+
+    static constexpr bool inputIssRGB(Strip::InputType input_type) {
+        return input_type == Strip::INPUT_sRGB8 || input_type == Strip::INPUT_sRGBW8;
+    }
+
+    static constexpr Strip::NativeType outputNativeType(Strip::OutputType output_type) {
+        switch(output_type) {
+            case Strip::SK6812_RGBW: {
+                return Strip::NATIVE_RGBW8;
+            } break;
+            default: {
+                return Strip::NATIVE_RGB8;
+            } break;
+            case Strip::HD108_RGB:
+            case Strip::WS2816_RGB: {
+                return Strip::NATIVE_RGB16;
+            } break;
+        }
+    }
+
+    static constexpr size_t outputPixelBytes(Strip::OutputType output_type) {
+        switch(outputNativeType(output_type)) {
             default:
-            case WS2812_RGB:
-            case SK6812_RGB:
-            case GS8208_RGB:
-            case TM1804_RGB:
-            case UCS1904_RGB:
-            case TLS3001_RGB:
-            case LPD8806_RGB:
-            case SK9822_RGB:
-            case HDS107S_RGB:
-            case P9813_RGB:
-            case TM1829_RGB:
-            case APA102_RGB:            
-            case WS2801_RGB: {
+            case Strip::NATIVE_RGB8: {
                 return 3;
             } break;
-            case HD108_RGB:
-            case WS2816_RGB: {
+            case Strip::NATIVE_RGBW8: {
+                return 4;
+            } break;
+            case Strip::NATIVE_RGB16: {
                 return 6;
             } break;
         }
-        return 0;
     }
 
-    Strip::NativeType Strip::nativeType() const {
+    // Position of the R, G, B and W components in a native pixel
+    static constexpr std::array<uint8_t, 4> outputOrder(Strip::OutputType output_type) {
         switch(output_type) {
-            case SK6812_RGBW: {
-                return NATIVE_RGBW8;
+            default: {
+                return { 1, 0, 2, 3 };
             } break;
-            default:
-            case WS2812_RGB:
-            case SK6812_RGB:
-            case GS8208_RGB:
-            case TM1804_RGB:
-            case TM1829_RGB:
-            case UCS1904_RGB:
-            case LPD8806_RGB:
-            case SK9822_RGB:
-            case HDS107S_RGB:
-            case P9813_RGB:
-            case APA102_RGB: 
-            case WS2801_RGB: {
-                return NATIVE_RGB8;
+            case Strip::APA107_RGB:
+            case Strip::APA102_RGB:
+            case Strip::TM1829_RGB: {
+                return { 2, 1, 0, 3 };
             } break;
-            case HD108_RGB:
-            case WS2816_RGB: {
-                return NATIVE_RGB16;
+            case Strip::HD108_RGB:
+            case Strip::TLS3001_RGB: {
+                return { 0, 1, 2, 3 };
+            } break;
+            case Strip::LPD8806_RGB: {
+                return { 2, 0, 1, 3 };
+            } break;
+        }
+    }
+
+    // Output types which share native type, component order and value
+    // corrections fill comp_buf identically, so they share one copy kernel.
+    static constexpr Strip::OutputType outputLayout(Strip::OutputType output_type) {
+        switch(output_type) {
+            default: {
+                return Strip::WS2812_RGB;
             } break;
+            case Strip::APA107_RGB:
+            case Strip::APA102_RGB:
+            case Strip::TM1829_RGB: {
+                return Strip::APA102_RGB;
+            } break;
+            case Strip::TLS3001_RGB:
+            case Strip::LPD8806_RGB:
+            case Strip::SK6812_RGBW:
+            case Strip::WS2816_RGB:
+            case Strip::HD108_RGB: {
+                return output_type;
+            } break;
+        }
+    }
+
+    static constexpr std::array<size_t, Strip::INPUT_TYPE_COUNT> make_input_pixel_bytes() {
+        std::array<size_t, Strip::INPUT_TYPE_COUNT> table = { 0 };
+        for (size_t c = 0; c < table.size(); c++) {
+            table[c] = inputPixelBytes(Strip::InputType(c));
         }
-        return NATIVE_RGB8;
+        return table;
+    }
+
+    static constexpr auto input_pixel_bytes = make_input_pixel_bytes();
+
+    size_t Strip::universePixelLen(InputType type) {
+        return dmxMaxLen / input_pixel_bytes[type < INPUT_TYPE_COUNT ? type : INPUT_dRGB8];
+    }
+
+    size_t Strip::getBytesPerPixel() const {
+        return outputPixelBytes(output_type);
+    }
+
+    Strip::NativeType Strip::nativeType() const {
+        return outputNativeType(output_type);
     }
 
     size_t Strip::getPixelLen() const {
-        const size_t pixsize = getBytesPerPixel();
-        return bytes_len / pixsize;
+        return pixel_len;
     }
 
     size_t Strip::getMaxPixelLen() const {
@@ -247,936 +342,1089 @@ namespace lightkraken {
 
     void Strip::setBytesLen(size_t len) {
         bytes_len = std::min(getMaxBytesLen(), size_t(len));
+        pixel_len = bytes_len / getBytesPerPixel();
         memset(&comp_buf.data()[bytes_len], 0, comp_buf.size()-bytes_len);
+#ifdef STRIP_DITHER
+        memset(&dither_buf.data()[bytes_len], 0, sizeof(DitherPixel) * (dither_buf.size()-bytes_len));
+#endif  // #ifdef STRIP_DITHER
+        updatePixelMap();
+        updateWireLayout();
     }
-    
-    bool Strip::isUniverseActive(size_t uniN, InputType input_type) const {
-        const size_t pixsize = getBytesPerInputPixel(input_type);
-        const size_t pixpad = size_t(dmxMaxLen / pixsize);
-        if (uniN * pixpad < getPixelLen()) {
-            return true;
-        }
-        return false;
+
+    void Strip::setStripType(OutputType type) {
+        output_type = type < OUTPUT_TYPE_COUNT ? type : WS2812_RGB;
+        pixel_len = bytes_len / getBytesPerPixel();
+#ifdef STRIP_DITHER
+        memset(dither_buf.data(), 0, sizeof(dither_buf));
+#endif  // #ifdef STRIP_DITHER
+        updateCopyKernel();
+        updatePixelMap();
+        updateWireLayout();
     }
 
-    size_t Strip::getBytesPerInputPixel(InputType input_type) const {
-        switch (input_type) {
-            default:
-            case INPUT_sRGB8: 
-            case INPUT_dRGB8: {
-                return 3;
-            } break;
-            case INPUT_sRGBW8: 
-            case INPUT_dRGBW8: {
-                return 4;
-            } break;
-            case INPUT_dRGB16LSB: 
-            case INPUT_dRGB16MSB: {
-                return 6;
-            } break;
-            case INPUT_dRGBW16LSB:
-            case INPUT_dRGBW16MSB: {
-                return 8;
-            }
-        }
-        return 0;
+    void Strip::setPixelMap(const Model::StripConfig::PixelMap &map) {
+        pixel_map = map;
+        updatePixelMap();
     }
 
-    size_t Strip::getComponentsPerInputPixel(InputType input_type) const {
-        switch (input_type) {
-            default:
-            case INPUT_dRGB16LSB:
-            case INPUT_dRGB16MSB:
-            case INPUT_sRGB8: 
-            case INPUT_dRGB8: {
-                return 3;
-            } break;
-            case INPUT_dRGBW16LSB:
-            case INPUT_dRGBW16MSB:
-            case INPUT_sRGBW8: 
-            case INPUT_dRGBW8: {
-                return 4;
-            } break;        
+    // Flattens the pixel map into runs of grouped pixels which map to evenly
+    // stepped physical pixels, so the copy kernels can write them in one
+    // pass. Rows which would not fit into the run table are dropped. Each
+    // input pixel then drives pixel_group consecutive grouped pixels.
+    void Strip::updatePixelMap() {
+        const size_t width = pixel_map.width ? pixel_map.width : pixel_len;
+        const size_t height = pixel_map.height ? pixel_map.height : pixel_len;
+        const size_t stride = width + pixel_map.gap;
+        pixel_run_count = 0;
+        map_len = 0;
+        for (size_t y = 0; y < height && width; y++) {
+            const size_t row = pixel_map.offset + y * stride;
+            if (row >= pixel_len) {
+                break;
+            }
+            const size_t len = std::min(width, pixel_len - row);
+            size_t logical = y * width;
+            int32_t step = 1;
+            size_t physical = row;
+            if (pixel_map.serpentine && (y & 1)) {
+                // A partial last row starts at its far end
+                logical += width - len;
+                physical = row + len - 1;
+                step = -1;
+            }
+            if (pixel_map.reverse) {
+                physical = pixel_len - 1 - physical;
+                step = -step;
+            }
+            if (pixel_run_count) {
+                PixelRun &prev = pixel_runs[pixel_run_count - 1];
+                if (prev.step == step &&
+                    size_t(prev.logical + prev.len) == logical &&
+                    int32_t(prev.physical) + int32_t(prev.len) * step == int32_t(physical)) {
+                    prev.len = uint16_t(prev.len + len);
+                    map_len = logical + len;
+                    continue;
+                }
+            }
+            if (pixel_run_count >= pixel_runs.size()) {
+                break;
+            }
+            pixel_runs[pixel_run_count++] = { uint16_t(logical), uint16_t(physical), uint16_t(len), int16_t(step) };
+            map_len = logical + len;
         }
-        return 0;
+        pixel_group = std::max(size_t(1), size_t(pixel_map.group));
+        group_len = (map_len + pixel_group - 1) / pixel_group;
+        updateUniverseMask();
     }
 
-    size_t Strip::getComponentBytes(InputType input_type) const {
-        switch (input_type) {
-            default:
-            case INPUT_dRGBW16LSB:
-            case INPUT_dRGBW16MSB:
-            case INPUT_dRGB16LSB:
-            case INPUT_dRGB16MSB: {
-                return 2;
-            } break;
-            case INPUT_sRGB8: 
-            case INPUT_dRGB8: 
-            case INPUT_sRGBW8: 
-            case INPUT_dRGBW8: {
-                return 1;
-            } break;
+    void Strip::updateUniverseMask() {
+        universe_mask = 0;
+        for (size_t c = 0; c < Model::universeN; c++) {
+            if (isUniverseActive(c, input_type)) {
+                universe_mask |= 1UL << c;
+            }
         }
-        return 0;
     }
 
-    void Strip::setData(const uint8_t *data, const size_t len, const InputType input_type) {
-
-        auto transfer = [=, this] (const std::vector<int> &order) {
-            const size_t input_size = getBytesPerInputPixel(input_type);
-            const size_t input_pad = size_t(dmxMaxLen / input_size) * order.size() * getComponentBytes(input_type); 
-            size_t left = len;
-            const uint8_t *ptr = data;
-            for (size_t c = 0; c <= ((len - 1) / input_pad); c++) {
-                size_t block = std::min(left, input_pad);
-                setUniverseData(c, ptr, block, input_type);
-                left -= block;
-                ptr += block;
-            }
-        };
+    void Strip::setSPI(SPI *output) {
+        spi = output;
+        updateWireLayout();
+    }
 
-        switch(output_type) {
-            default:
-            case SK9822_RGB:
-            case HDS107S_RGB:
-            case P9813_RGB:
-            case WS2812_RGB:
-            case WS2816_RGB:
-            case SK6812_RGB:
-            case TM1804_RGB:
-            case GS8208_RGB:
-            case UCS1904_RGB: {
-                const std::vector<int> order = { 1, 0, 2 };
-                transfer(order);
-            } break;
-            case APA107_RGB:
-            case APA102_RGB:
-            case TM1829_RGB: {
-                const std::vector<int> order = { 2, 1, 0 };
-                transfer(order);
-            } break;
-            case HD108_RGB:
-            case TLS3001_RGB: {
-                const std::vector<int> order = { 0, 1, 2 };
-                transfer(order);
-            } break;
-            case SK6812_RGBW: {
-                const std::vector<int> order = { 1, 0, 2, 3 };
-                transfer(order);
-            } break;
-            case LPD8806_RGB: {
-                const std::vector<int> order = { 2, 0, 1 };
-                transfer(order);
-            } break;
-            case WS2801_RGB: {
-                const std::vector<int> order = { 1, 0, 2 };
-                transfer(order);
-            } break;
+    // Refused, and nothing mirrored, if the mirror can't run at the bit rate
+    // of the strip's own SPI
+    bool Strip::setMirrorSPI(SPI *output) {
+        mirror = output;
+        uint32_t shift = 0;
+        if (mirror && !mirrorPrescaler(shift)) {
+            mirror = 0;
         }
+        return mirror != 0;
     }
 
+    void Strip::setGlobIllum(uq16 value) {
+        uint8_t illum5 = uint8_t(value.clamp(uq16(), uq16::one()).scale(uint32_t(0x1f)));
+        illum8 = 0b11100000 | illum5;
+        illum16 = 0b1000'0000'0000'0000 | (illum5 << 10) | (illum5 << 5) | illum5;
+        wire_stale.fill(wireStaleAll);
+        content_valid = false;
+        content_dirty = true;
+    }
 
-    __attribute__ ((hot, optimize("O3"), optimize("unroll-loops")))
-    void Strip::setUniverseData(const size_t uniN, const uint8_t *data, const size_t len, const InputType input_type) {
+    void Strip::setInputType(InputType type) {
+        input_type = type < INPUT_TYPE_COUNT ? type : INPUT_dRGB8;
+        updateCopyKernel();
+        updateChannelMap();
+    }
 
-        __assume(uniN < Model::universeN);
-        __assume(len <= 512);
-        __assume(input_type < INPUT_TYPE_COUNT);
+    void Strip::setStartChannel(size_t channel, bool continuous) {
+        start_channel = std::clamp(channel, size_t(1), dmxMaxLen) - 1;
+        channel_continuous = continuous;
+        updateChannelMap();
+    }
 
-        PerfMeasure perf(PerfMeasure::SLOT_STRIP_COPY);
+    // The first universe starts at start_channel. In continuous mode the
+    // universes then form one channel stream, otherwise every further one
+    // starts with a whole pixel at its first channel. For each universe this
+    // precomputes the first whole pixel in it and how many leading bytes
+    // still belong to the pixel split off the end of the previous universe.
+    void Strip::updateChannelMap() {
+        const size_t input_size = input_pixel_bytes[input_type];
+        static_assert(inputPixelBytes(INPUT_dRGBW16MSB) <= sizeof(channel_split[0]));
+        for (size_t c = 0; c < Model::universeN; c++) {
+            if (c == 0) {
+                channel_skip[c] = uint16_t(start_channel);
+                channel_first[c] = 0;
+            } else if (!channel_continuous) {
+                const size_t head = (dmxMaxLen - start_channel) / input_size;
+                channel_skip[c] = 0;
+                channel_first[c] = uint16_t(head + (c - 1) * (dmxMaxLen / input_size));
+            } else {
+                const size_t pos = c * dmxMaxLen - start_channel;
+                const size_t skip = (input_size - pos % input_size) % input_size;
+                channel_skip[c] = uint16_t(skip);
+                channel_first[c] = uint16_t((pos + skip) / input_size);
+            }
+        }
+        updateUniverseMask();
+    }
 
-        if (uniN >= lightkraken::Model::universeN) {
-            return;
+    void Strip::setCompLimit(uq16 value) {
+        value = value.clamp(uq16(), uq16::one());
+        limit_8bit = value.scale(uint32_t(0xFF));
+        limit_16bit = value.scale(uint32_t(0xFFFF));
+        updateWireLayout();
+    }
+
+    void Strip::updateCopyKernel() {
+        copy_kernel = copy_kernels[size_t(input_type) * OUTPUT_TYPE_COUNT + size_t(output_type)];
+    }
+    
+    bool Strip::isUniverseActive(size_t uniN, InputType type) const {
+        if (type == input_type) {
+            const size_t first = channel_first[uniN] - (channel_continuous && channel_skip[uniN] && uniN ? 1 : 0);
+            return first < group_len;
+        }
+        const size_t pixpad = size_t(dmxMaxLen / input_pixel_bytes[type]);
+        if (uniN * pixpad < group_len) {
+            return true;
         }
+        return false;
+    }
 
-        if (!isUniverseActive(uniN, input_type)) {
-            return;
+    void Strip::setData(const uint8_t *data, const size_t len, const InputType type) {
+        const size_t input_size = input_pixel_bytes[type];
+        const size_t input_pad = size_t(dmxMaxLen / input_size) * input_size;
+        for (size_t c = 0, off = 0; off < len && c < Model::universeN; c++, off += input_pad) {
+            copyUniverse(c, data + off, std::min(len - off, input_pad), type, false);
         }
+    }
+
+    template<Strip::InputType I, Strip::OutputType O>
+    __attribute__ ((hot, optimize("O3"), optimize("unroll-loops")))
+    void Strip::copyKernel(const uint8_t *src, size_t first, size_t count, int32_t step, size_t group, size_t phase) {
 
-        auto transfer = [=, this] (const std::vector<int> &order) {
-            const uint32_t limit_8bit = uint32_t(std::clamp(comp_limit, 0.0f, 1.0f) * 255.f);
-            const uint32_t limit_16bit = uint32_t(std::clamp(comp_limit, 0.0f, 1.0f) * 65535.f);
-            const size_t input_size = getBytesPerInputPixel(input_type);
-            const size_t pixel_pad = std::min(getComponentsPerInputPixel(input_type), order.size());
-            const size_t input_pad = size_t(dmxMaxLen / input_size) * order.size() * getComponentBytes(input_type); 
-            const size_t pixel_loop_n = std::min(len, input_pad);
-            const size_t order_size = order.size();
+        static constexpr size_t in_size = inputPixelBytes(I);
+        static constexpr size_t out_size = outputPixelBytes(O);
+        static constexpr std::array<uint8_t, 4> order = outputOrder(O);
+        static constexpr NativeType native = outputNativeType(O);
 
-            __assume(pixel_loop_n > 0);
+        static constexpr auto ws2816b_lut = make_ws2816b_error_lut();
+        auto fix_for_ws2816b = [] (const uint32_t v) {
+            if (O == WS2816_RGB && v < ws2816b_lut.size()) {
+                return uint32_t(ws2816b_lut[v]);
+            }
+            return v;
+        };
 
-            __assume(limit_8bit <= 255);
-            __assume(limit_16bit <= 65535);
+        // Upper 8 bits of input component i
+        auto read8 = [=] (const uint8_t *p, const size_t i) {
+            if (inputIs16Bit(I)) {
+                return uint32_t(p[i * 2 + (inputIsLSB(I) ? 1 : 0)]);
+            }
+            return uint32_t(p[i]);
+        };
 
-            __assume(input_size > 0);
-            __assume(pixel_pad > 0);
-            __assume(input_size <= 8);
-            __assume(pixel_pad <= 4);
-            __assume(input_pad > 0);
-            __assume(input_pad < dmxMaxLen);
+        // Input component i widened to 16 bits
+        auto read16 = [=] (const uint8_t *p, const size_t i) {
+            if (inputIs16Bit(I)) {
+                if (inputIsLSB(I)) {
+                    return (uint32_t(p[i * 2 + 1]) << 8) | uint32_t(p[i * 2 + 0]);
+                }
+                return (uint32_t(p[i * 2 + 0]) << 8) | uint32_t(p[i * 2 + 1]);
+            }
+            return uint32_t(p[i]) * 0x0101;
+        };
 
+        auto write16 = [=] (uint8_t *p, const size_t i, const uint32_t v) {
+            p[order[i] * 2 + 0] = uint8_t(v >> 8);
+            p[order[i] * 2 + 1] = uint8_t(v >> 0);
+        };
 
+        // Components as 8-bit drive levels for the power estimate
+        const uint32_t ls = limit_8bit;
+        auto steps = [=] (const uint8_t *p) {
+            if (native == NATIVE_RGB16) {
+                return uint32_t(p[0]) + uint32_t(p[2]) + uint32_t(p[4]);
+            }
+            uint32_t sum = std::min(ls, uint32_t(p[0])) + std::min(ls, uint32_t(p[1])) + std::min(ls, uint32_t(p[2]));
+            if (native == NATIVE_RGBW8) {
+                sum += std::min(ls, uint32_t(p[3]));
+            }
+            return sum;
+        };
 
-            auto fix_for_ws2816b = [=] (const uint16_t v) { 
-                static constexpr auto lut = make_ws2816b_error_lut();
-                if (v < lut.size()) {
-                    return lut[v];
-                }
-                return v;
-            };
-
-            switch (input_type) {
-                default:
-                case INPUT_dRGB8: {
-                    switch (nativeType()) {
-                        default: {
-                        } break;
-                        case NATIVE_RGB8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 3, n += order_size) {
-                                for (size_t d = 0; d < pixel_pad; d++) {
-                                    buf[n + order[d]] = std::min(limit_8bit, uint32_t(data[c + d]));
-                                }
-                            }
-                        } break;
-                        case NATIVE_RGBW8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 3, n += 4) {
-                                uint32_t r = std::min(limit_8bit, uint32_t(data[c + 0]));
-                                uint32_t g = std::min(limit_8bit, uint32_t(data[c + 1]));
-                                uint32_t b = std::min(limit_8bit, uint32_t(data[c + 2]));
-                                uint32_t m = std::min(r, std::min(g, b));
-                                buf[n + order[0]] = r - m;
-                                buf[n + order[1]] = g - m;
-                                buf[n + order[2]] = b - m;
-                                buf[n + order[3]] = m;
-                            }
-                        } break;
-                        case NATIVE_RGB16: {
-                            if (output_type == WS2816_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 3, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { uint32_t v = uint32_t(data[c + i]); v = (v << 8) | v; return v; };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    write_buf(0, fix_for_ws2816b(uint16_t(std::min(limit_16bit, read_buf(1)))));
-                                    write_buf(1, fix_for_ws2816b(uint16_t(std::min(limit_16bit, read_buf(0)))));
-                                    write_buf(2, fix_for_ws2816b(uint16_t(std::min(limit_16bit, read_buf(2)))));
-                                }
-                                return;
-                            }
-                            if (output_type == HD108_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 3, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { uint32_t v = uint32_t(data[c + i]); return v; };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint32_t r = hd108_lut[0][read_buf(0)];
-                                    uint32_t g = hd108_lut[1][read_buf(1)];
-                                    uint32_t b = hd108_lut[2][read_buf(2)];
-
-                                    write_buf(0, uint16_t(std::min(limit_16bit, r)));
-                                    write_buf(1, uint16_t(std::min(limit_16bit, g)));
-                                    write_buf(2, uint16_t(std::min(limit_16bit, b)));
-                                }
-                                return;
-                            }
-                        } break;
+        const uint32_t l8 = copy_limit_8bit;
+        const uint32_t l16 = limit_16bit;
+
+        const ptrdiff_t dst_step = ptrdiff_t(step) * ptrdiff_t(out_size);
+        uint8_t *dst = &comp_buf[first * out_size];
+#ifdef STRIP_DITHER
+        // 16-bit input keeps its low byte for temporal dithering, everything
+        // else on an 8-bit strip clears it.
+        static constexpr bool native8 = native == NATIVE_RGB8 || native == NATIVE_RGBW8;
+        static constexpr bool dither = native8 && inputIs16Bit(I);
+        DitherPixel *fdst = &dither_buf[first * out_size];
+        [[maybe_unused]] auto write8 = [&] (const size_t i, const uint32_t v) {
+            dst[order[i]] = uint8_t(v >> 8);
+            fdst[order[i]].fraction = uint8_t(v);
+        };
+#endif  // #ifdef STRIP_DITHER
+        uint32_t sum = comp_sum;
+        for (size_t c = 0; c < count; src += in_size) {
+            sum -= steps(dst);
+            switch (native) {
+                case NATIVE_RGB8: {
+#ifdef STRIP_DITHER
+                    if constexpr (dither) {
+                        const uint32_t l = l8 << 8;
+                        const uint32_t w = inputHasWhite(I) ? read16(src, 3) : 0;
+                        write8(0, std::min(l, read16(src, 0) + w));
+                        write8(1, std::min(l, read16(src, 1) + w));
+                        write8(2, std::min(l, read16(src, 2) + w));
+                        break;
                     }
-                } break;
-                case INPUT_dRGBW8: {
-                    switch (nativeType()) {
-                        default: {
-                        } break;
-                        case NATIVE_RGB8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 4, n += 3) {
-                                uint32_t r = uint32_t(data[c + 0]);
-                                uint32_t g = uint32_t(data[c + 1]);
-                                uint32_t b = uint32_t(data[c + 2]); 
-                                uint32_t w = uint32_t(data[c + 3]);
-
-                                buf[n + order[0]] = uint8_t(std::min(r+w, limit_8bit));
-                                buf[n + order[1]] = uint8_t(std::min(g+w, limit_8bit));
-                                buf[n + order[2]] = uint8_t(std::min(b+w, limit_8bit));
-                            }
-                        } break;
-                        case NATIVE_RGBW8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 4, n += order_size) {
-                                for (size_t d = 0; d < pixel_pad; d++) {
-                                    buf[n + order[d]] = std::min(limit_8bit, uint32_t(data[c + d]));
-                                }
-                            }
-                        } break;
-                        case NATIVE_RGB16: {
-                            if (output_type == WS2816_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 4, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { uint32_t v = uint32_t(data[c + i]); v = (v << 8) | v; return v; };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint32_t r = read_buf(0);
-                                    uint32_t g = read_buf(1);
-                                    uint32_t b = read_buf(2);
-                                    uint32_t w = read_buf(3);
-
-                                    r = fix_for_ws2816b(uint16_t(std::min(limit_16bit, r+w)));
-                                    g = fix_for_ws2816b(uint16_t(std::min(limit_16bit, g+w)));
-                                    b = fix_for_ws2816b(uint16_t(std::min(limit_16bit, b+w)));
-
-                                    write_buf(0, g);
-                                    write_buf(1, r);
-                                    write_buf(2, b);
-                                }
-                                return;
-                            }
-                            if (output_type == HD108_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 4, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { uint32_t v = uint32_t(data[c + i]); return v; };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint32_t r = read_buf(0);
-                                    uint32_t g = read_buf(1);
-                                    uint32_t b = read_buf(2);
-                                    uint32_t w = read_buf(3);
-
-                                    r = uint8_t(std::min(limit_8bit, r+w));
-                                    g = uint8_t(std::min(limit_8bit, g+w));
-                                    b = uint8_t(std::min(limit_8bit, b+w));
-
-                                    r = hd108_lut[0][r];
-                                    g = hd108_lut[1][g];
-                                    b = hd108_lut[2][b];
-
-                                    write_buf(0, r);
-                                    write_buf(1, g);
-                                    write_buf(2, b);
-                                }
-                                return;
-                            }
-                        } break;
+#endif  // #ifdef STRIP_DITHER
+                    uint32_t r = 0, g = 0, b = 0, w = 0;
+                    if (inputIssRGB(I)) {
+                        uint16_t lr = 0, lg = 0, lb = 0;
+                        converter.sRGB8toLEDPWM(src[0], src[1], src[2], 255, lr, lg, lb);
+                        r = lr; g = lg; b = lb;
+                    } else {
+                        r = read8(src, 0); g = read8(src, 1); b = read8(src, 2);
                     }
-                } break;
-                case INPUT_sRGB8: {
-                    switch (nativeType()) {
-                        default: {
-                        } break;
-                        case NATIVE_RGB8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 3, n += 3) {
-                                uint8_t sr = data[c + 0];
-                                uint8_t sg = data[c + 1];
-                                uint8_t sb = data[c + 2];
-
-                                uint16_t lr = 0;
-                                uint16_t lg = 0;
-                                uint16_t lb = 0;
-    
-                                converter.sRGB8toLEDPWM(
-                                    sr, sg, sb, 255,
-                                    lr, lg, lb);
-
-                                lr = std::min(uint16_t(limit_8bit), lr);
-                                lg = std::min(uint16_t(limit_8bit), lg);
-                                lb = std::min(uint16_t(limit_8bit), lb);
-
-                                buf[n + order[0]] = lr;
-                                buf[n + order[1]] = lg;
-                                buf[n + order[2]] = lb;
-                            }
-                        } break;
-                        case NATIVE_RGBW8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 3, n += 3) {
-                                uint8_t sr = data[c + 0];
-                                uint8_t sg = data[c + 1];
-                                uint8_t sb = data[c + 2];
-
-                                uint16_t lr = 0;
-                                uint16_t lg = 0;
-                                uint16_t lb = 0;
-    
-                                converter.sRGB8toLEDPWM(
-                                    sr, sg, sb, 255,
-                                    lr, lg, lb);
-
-                                uint16_t lm = std::min(lr, std::min(lg, lb));
-
-                                lr = std::min(uint16_t(limit_8bit), lr);
-                                lg = std::min(uint16_t(limit_8bit), lg);
-                                lb = std::min(uint16_t(limit_8bit), lb);
-                                lm = std::min(uint16_t(limit_8bit), lm);
-
-                                buf[n + order[0]] = lr - lm;
-                                buf[n + order[1]] = lg - lm;
-                                buf[n + order[2]] = lb - lm;
-                                buf[n + order[3]] = lm;
-                            }
-                        } break;
-                        case NATIVE_RGB16: {
-                            if (output_type == WS2816_RGB) {
-                                uint16_t *buf = reinterpret_cast<uint16_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 3, n += 3) {
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint8_t sr = data[c + 0];
-                                    uint8_t sg = data[c + 1];
-                                    uint8_t sb = data[c + 2];
-
-                                    uint16_t lr = 0;
-                                    uint16_t lg = 0;
-                                    uint16_t lb = 0;
-        
-                                    converter.sRGB8toLEDPWM(
-                                        sr, sg, sb, 65535,
-                                        lr, lg, lb);
-
-                                    lr = fix_for_ws2816b(std::min(uint16_t(limit_16bit), lr));
-                                    lg = fix_for_ws2816b(std::min(uint16_t(limit_16bit), lg));
-                                    lb = fix_for_ws2816b(std::min(uint16_t(limit_16bit), lb));
-
-                                    write_buf(0, lg);
-                                    write_buf(1, lr);
-                                    write_buf(2, lb);
-                                }
-                                return;
-                            }
-                            if (output_type == HD108_RGB) {
-                                uint16_t *buf = reinterpret_cast<uint16_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 3, n += 3) {
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint8_t sr = data[c + 0];
-                                    uint8_t sg = data[c + 1];
-                                    uint8_t sb = data[c + 2];
-
-                                    uint16_t lr = 0;
-                                    uint16_t lg = 0;
-                                    uint16_t lb = 0;
-
-                                    converter.sRGB8toLEDPWM(
-                                        sr, sg, sb, 65535,
-                                        lr, lg, lb);
-
-                                    // TODO: HD108 lut
-
-                                    lr = std::min(uint16_t(limit_16bit), lr);
-                                    lg = std::min(uint16_t(limit_16bit), lg);
-                                    lb = std::min(uint16_t(limit_16bit), lb);
-
-                                    write_buf(0, lr);
-                                    write_buf(1, lg);
-                                    write_buf(2, lb);
-                                }
-                                return;
-                            }
-                        } break;
+                    if (inputHasWhite(I)) {
+                        w = read8(src, 3);
                     }
+                    dst[order[0]] = uint8_t(std::min(l8, r + w));
+                    dst[order[1]] = uint8_t(std::min(l8, g + w));
+                    dst[order[2]] = uint8_t(std::min(l8, b + w));
                 } break;
-                case INPUT_sRGBW8: {
-                    switch (nativeType()) {
-                        default: {
-                        } break;
-                        case NATIVE_RGB8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 4, n += 3) {
-                                uint8_t sr = uint8_t(data[c + 0]);
-                                uint8_t sg = uint8_t(data[c + 1]);
-                                uint8_t sb = uint8_t(data[c + 2]); 
-                                uint8_t lw = uint8_t(data[c + 3]);
-
-                                uint16_t lr = 0;
-                                uint16_t lg = 0;
-                                uint16_t lb = 0;
-    
-                                converter.sRGB8toLEDPWM(
-                                    sr, sg, sb, 255,
-                                    lr, lg, lb);
-
-                                buf[n + order[0]] = uint8_t(std::min(uint32_t(lr+uint16_t(lw)), limit_8bit));
-                                buf[n + order[1]] = uint8_t(std::min(uint32_t(lg+uint16_t(lw)), limit_8bit));
-                                buf[n + order[2]] = uint8_t(std::min(uint32_t(lb+uint16_t(lw)), limit_8bit));
-                            }
-                        } break;
-                        case NATIVE_RGBW8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 4, n += 4) {
-                                uint8_t sr = uint8_t(data[c + 0]);
-                                uint8_t sg = uint8_t(data[c + 1]);
-                                uint8_t sb = uint8_t(data[c + 2]); 
-                                uint8_t lw = uint8_t(data[c + 3]);
-
-                                uint16_t lr = 0;
-                                uint16_t lg = 0;
-                                uint16_t lb = 0;
-    
-                                converter.sRGB8toLEDPWM(
-                                    sr, sg, sb, 255,
-                                    lr, lg, lb);
-
-                                buf[n + order[0]] = uint8_t(std::min(uint32_t(lr), limit_8bit));
-                                buf[n + order[1]] = uint8_t(std::min(uint32_t(lg), limit_8bit));
-                                buf[n + order[2]] = uint8_t(std::min(uint32_t(lb), limit_8bit));
-                                buf[n + order[3]] = uint8_t(std::min(uint32_t(lw), limit_8bit));
-                            }
-                        } break;
-                        case NATIVE_RGB16: {
-                            if (output_type == WS2816_RGB) {
-                                uint16_t *buf = reinterpret_cast<uint16_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 4, n += 3) {
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint8_t sr = uint8_t(data[c + 0]);
-                                    uint8_t sg = uint8_t(data[c + 1]);
-                                    uint8_t sb = uint8_t(data[c + 2]); 
-                                    uint8_t lw = uint8_t(data[c + 3]);
-
-                                    uint16_t lr = 0;
-                                    uint16_t lg = 0;
-                                    uint16_t lb = 0;
-        
-                                    converter.sRGB8toLEDPWM(
-                                        sr, sg, sb, 65535,
-                                        lr, lg, lb);
-
-                                    lw = (lw << 8) | lw;
-
-                                    lr = fix_for_ws2816b(std::min(limit_8bit, uint32_t(lr) + uint32_t(lw)));
-                                    lg = fix_for_ws2816b(std::min(limit_8bit, uint32_t(lg) + uint32_t(lw)));
-                                    lb = fix_for_ws2816b(std::min(limit_8bit, uint32_t(lb) + uint32_t(lw)));
-
-                                    write_buf(0, lg);
-                                    write_buf(1, lr);
-                                    write_buf(2, lb);
-                                }
-                                return;
-                            }
-                            if (output_type == HD108_RGB) {
-                                uint16_t *buf = reinterpret_cast<uint16_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 4, n += 3) {
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint8_t sr = uint8_t(data[c + 0]);
-                                    uint8_t sg = uint8_t(data[c + 1]);
-                                    uint8_t sb = uint8_t(data[c + 2]); 
-                                    uint8_t lw = uint8_t(data[c + 3]);
-
-                                    uint16_t lr = 0;
-                                    uint16_t lg = 0;
-                                    uint16_t lb = 0;
-        
-                                    converter.sRGB8toLEDPWM(
-                                        sr, sg, sb, 65535,
-                                        lr, lg, lb);
-
-                                    lw = (lw << 8) | lw;
-
-                                    // TODO: HD108 lut
-
-                                    lr = std::min(limit_8bit, uint32_t(lr) + uint32_t(lw));
-                                    lg = std::min(limit_8bit, uint32_t(lg) + uint32_t(lw));
-                                    lb = std::min(limit_8bit, uint32_t(lb) + uint32_t(lw));
-
-                                    write_buf(0, lr);
-                                    write_buf(1, lg);
-                                    write_buf(2, lb);
-                                }
-                                return;
-                            }
-                        } break;
+                case NATIVE_RGBW8: {
+#ifdef STRIP_DITHER
+                    if constexpr (dither) {
+                        const uint32_t l = l8 << 8;
+                        const uint32_t r = std::min(l, read16(src, 0));
+                        const uint32_t g = std::min(l, read16(src, 1));
+                        const uint32_t b = std::min(l, read16(src, 2));
+                        if (inputHasWhite(I)) {
+                            write8(0, r);
+                            write8(1, g);
+                            write8(2, b);
+                            write8(3, std::min(l, read16(src, 3)));
+                        } else {
+                            const uint32_t m = std::min(r, std::min(g, b));
+                            write8(0, r - m);
+                            write8(1, g - m);
+                            write8(2, b - m);
+                            write8(3, m);
+                        }
+                        break;
                     }
-                } break;
-                case INPUT_dRGB16LSB: {
-                    switch (nativeType()) {
-                        default: {
-                        } break;
-                        case NATIVE_RGB8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 6, n += order_size) {
-                                for (size_t d = 0; d < pixel_pad; d++) {
-                                    buf[n + order[d]] = std::min(limit_8bit, uint32_t(data[c + d * 2 + 1]));
-                                }
-                            }
-                        } break;
-                        case NATIVE_RGBW8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 6, n += 4) {
-                                auto read_buf = [=] (const size_t i) { return uint32_t(data[c + i*2 + 1]); };
-                                auto write_buf = [=] (const size_t i, const uint8_t p) { buf[n + order[i]] = p; };
-
-                                uint32_t r = std::min(limit_8bit, read_buf(0));
-                                uint32_t g = std::min(limit_8bit, read_buf(1));
-                                uint32_t b = std::min(limit_8bit, read_buf(2));
-
-                                uint32_t m = std::min(r, std::min(g, b));
-
-                                write_buf(0, r - m);
-                                write_buf(1, g - m);
-                                write_buf(2, b - m);
-                                write_buf(3, m);
-                            }
-                        } break;
-                        case NATIVE_RGB16: {
-                            if (output_type == WS2816_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 6, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { return uint32_t(*reinterpret_cast<const uint16_t *>(&data[c+i*2])); };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    write_buf(0, fix_for_ws2816b(std::min(limit_16bit, read_buf(1))));
-                                    write_buf(1, fix_for_ws2816b(std::min(limit_16bit, read_buf(0))));
-                                    write_buf(2, fix_for_ws2816b(std::min(limit_16bit, read_buf(2))));
-                                }
-                                return;
-                            }
-                            if (output_type == HD108_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 6, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { return uint32_t(*reinterpret_cast<const uint16_t *>(&data[c+i*2])); };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    write_buf(0, std::min(limit_16bit, read_buf(0)));
-                                    write_buf(1, std::min(limit_16bit, read_buf(1)));
-                                    write_buf(2, std::min(limit_16bit, read_buf(2)));
-                                }
-                                return;
-                            }
-                        } break;
+#endif  // #ifdef STRIP_DITHER
+                    uint32_t r = 0, g = 0, b = 0;
+                    if (inputIssRGB(I)) {
+                        uint16_t lr = 0, lg = 0, lb = 0;
+                        converter.sRGB8toLEDPWM(src[0], src[1], src[2], 255, lr, lg, lb);
+                        r = lr; g = lg; b = lb;
+                    } else {
+                        r = read8(src, 0); g = read8(src, 1); b = read8(src, 2);
                     }
-                } break;
-                case INPUT_dRGB16MSB: {
-                    switch (nativeType()) {
-                        default: {
-                        } break;
-                        case NATIVE_RGB8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 6, n += order_size) {
-                                for (size_t d = 0; d < pixel_pad; d++) {
-                                    buf[n + order[d]] = std::min(limit_8bit, uint32_t(data[c + d * 2 + 0]));
-                                }
-                            }
-                        } break;
-                        case NATIVE_RGBW8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 6, n += 4) {
-                                auto read_buf = [=] (const size_t i) { return uint32_t(data[c + i*2]); };
-                                auto write_buf = [=] (const size_t i, const uint8_t p) { buf[n + order[i]] = p; };
-
-                                uint32_t r = std::min(limit_8bit, read_buf(0));
-                                uint32_t g = std::min(limit_8bit, read_buf(1));
-                                uint32_t b = std::min(limit_8bit, read_buf(2));
-
-                                uint32_t m = std::min(r, std::min(g, b));
-
-                                write_buf(0, r - m);
-                                write_buf(1, g - m);
-                                write_buf(2, b - m);
-                                write_buf(3, m);
-                            }
-                        } break;
-                        case NATIVE_RGB16: {
-                            if (output_type == WS2816_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 6, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { return uint32_t(__builtin_bswap16(*reinterpret_cast<const uint16_t *>(&data[c+i*2]))); };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    write_buf(0, fix_for_ws2816b(uint16_t(std::min(limit_16bit, read_buf(1)))));
-                                    write_buf(1, fix_for_ws2816b(uint16_t(std::min(limit_16bit, read_buf(0)))));
-                                    write_buf(2, fix_for_ws2816b(uint16_t(std::min(limit_16bit, read_buf(2)))));
-                                }
-                                return;
-                            }
-                            if (output_type == HD108_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 6, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { return uint32_t(__builtin_bswap16(*reinterpret_cast<const uint16_t *>(&data[c+i*2]))); };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    write_buf(0, uint16_t(std::min(limit_16bit, read_buf(0))));
-                                    write_buf(1, uint16_t(std::min(limit_16bit, read_buf(1))));
-                                    write_buf(2, uint16_t(std::min(limit_16bit, read_buf(2))));
-                                }
-                                return;
-                            }
-                        } break;
+                    if (inputHasWhite(I)) {
+                        dst[order[0]] = uint8_t(std::min(l8, r));
+                        dst[order[1]] = uint8_t(std::min(l8, g));
+                        dst[order[2]] = uint8_t(std::min(l8, b));
+                        dst[order[3]] = uint8_t(std::min(l8, read8(src, 3)));
+                    } else {
+                        r = std::min(l8, r);
+                        g = std::min(l8, g);
+                        b = std::min(l8, b);
+                        uint32_t m = std::min(r, std::min(g, b));
+                        dst[order[0]] = uint8_t(r - m);
+                        dst[order[1]] = uint8_t(g - m);
+                        dst[order[2]] = uint8_t(b - m);
+                        dst[order[3]] = uint8_t(m);
                     }
                 } break;
-                case INPUT_dRGBW16LSB: {
-                    switch (nativeType()) {
-                        default: {
-                        } break;
-                        case NATIVE_RGB8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 8, n += 3) {
-                                auto read_buf = [=] (const size_t i) { return uint32_t(*reinterpret_cast<const uint16_t *>(&data[c+i*2+1])); };
-                                auto write_buf = [=] (const size_t i, const uint8_t p) {buf[n + order[i]] = p; };
-
-                                uint32_t r = read_buf(0);
-                                uint32_t g = read_buf(1);
-                                uint32_t b = read_buf(2);
-                                uint32_t w = read_buf(3);
-
-                                write_buf(0, uint8_t(std::min(limit_8bit, r+w)));
-                                write_buf(1, uint8_t(std::min(limit_8bit, g+w)));
-                                write_buf(2, uint8_t(std::min(limit_8bit, b+w)));
-                            }
-                        } break;
-                        case NATIVE_RGBW8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 8, n += order_size) {
-                                for (size_t d = 0; d < pixel_pad; d++) {
-                                    buf[n + order[d]] = std::min(limit_8bit, uint32_t(data[c + d * 2 + 1]));
-                                }
-                            }
-                        } break;
-                        case NATIVE_RGB16: {
-                            if (output_type == WS2816_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 8, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { return uint32_t(*reinterpret_cast<const uint16_t *>(&data[c+i*2])); };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint32_t r = read_buf(0);
-                                    uint32_t g = read_buf(1);
-                                    uint32_t b = read_buf(2);
-                                    uint32_t w = read_buf(3);
-
-                                    write_buf(0, fix_for_ws2816b(uint16_t(std::min(limit_16bit, g+w))));
-                                    write_buf(1, fix_for_ws2816b(uint16_t(std::min(limit_16bit, r+w))));
-                                    write_buf(2, fix_for_ws2816b(uint16_t(std::min(limit_16bit, b+w))));
-                                }
-                                return;
-                            }
-                            if (output_type == HD108_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 8, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { return uint32_t(*reinterpret_cast<const uint16_t *>(&data[c+i*2])); };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint32_t r = read_buf(0);
-                                    uint32_t g = read_buf(1);
-                                    uint32_t b = read_buf(2);
-                                    uint32_t w = read_buf(3);
-
-                                    write_buf(0, uint16_t(std::min(limit_16bit, r+w)));
-                                    write_buf(1, uint16_t(std::min(limit_16bit, g+w)));
-                                    write_buf(2, uint16_t(std::min(limit_16bit, b+w)));
-                                }
-                                return;
-                            }
-                        } break;
+                case NATIVE_RGB16: {
+                    uint32_t r = 0, g = 0, b = 0, w = 0;
+                    if (inputIssRGB(I)) {
+                        uint16_t lr = 0, lg = 0, lb = 0;
+                        converter.sRGB8toLEDPWM(src[0], src[1], src[2], 65535, lr, lg, lb);
+                        r = lr; g = lg; b = lb;
+                        if (inputHasWhite(I)) {
+                            w = read16(src, 3);
+                        }
+                    } else if (O == HD108_RGB && !inputIs16Bit(I)) {
+                        // 8-bit input gets the HD108 response curve applied
+                        if (inputHasWhite(I)) {
+                            w = read8(src, 3);
+                        }
+                        r = hd108_lut[0][std::min(uint32_t(0xFF), read8(src, 0) + w)];
+                        g = hd108_lut[1][std::min(uint32_t(0xFF), read8(src, 1) + w)];
+                        b = hd108_lut[2][std::min(uint32_t(0xFF), read8(src, 2) + w)];
+                        w = 0;
+                    } else {
+                        r = read16(src, 0); g = read16(src, 1); b = read16(src, 2);
+                        if (inputHasWhite(I)) {
+                            w = read16(src, 3);
+                        }
                     }
+                    write16(dst, 0, fix_for_ws2816b(std::min(l16, r + w)));
+                    write16(dst, 1, fix_for_ws2816b(std::min(l16, g + w)));
+                    write16(dst, 2, fix_for_ws2816b(std::min(l16, b + w)));
                 } break;
-                case INPUT_dRGBW16MSB: {
-                    switch (nativeType()) {
-                        default: {
-                        } break;
-                        case NATIVE_RGB8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 8, n += 3) {
-                                auto read_buf = [=] (const size_t i) { return uint32_t(*reinterpret_cast<const uint16_t *>(&data[c+i*2+0])); };
-
-                                uint32_t r = read_buf(0);
-                                uint32_t g = read_buf(1);
-                                uint32_t b = read_buf(2);
-                                uint32_t w = read_buf(3);
-
-                                buf[n + order[0]] = uint8_t(std::min(limit_8bit, r+w));
-                                buf[n + order[1]] = uint8_t(std::min(limit_8bit, g+w));
-                                buf[n + order[2]] = uint8_t(std::min(limit_8bit, b+w));
-                            }
-                        } break;
-                        case NATIVE_RGBW8: {
-                            uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                            for (size_t c = 0, n = 0; c < pixel_loop_n; c += 8, n += order_size) {
-                                for (size_t d = 0; d < pixel_pad; d++) {
-                                    buf[n + order[d]] = std::min(limit_8bit, uint32_t(data[c + d * 2 + 0]));
-                                }
-                            }
-                        } break;
-                        case NATIVE_RGB16: {
-                            if (output_type == WS2816_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 8, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { return uint32_t(__builtin_bswap16(*reinterpret_cast<const uint16_t *>(&data[c+i*2]))); };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint32_t r = read_buf(0);
-                                    uint32_t g = read_buf(1);
-                                    uint32_t b = read_buf(2);
-                                    uint32_t w = read_buf(3);
-
-                                    r = fix_for_ws2816b(uint16_t(std::min(limit_16bit, r+w)));
-                                    g = fix_for_ws2816b(uint16_t(std::min(limit_16bit, g+w)));
-                                    b = fix_for_ws2816b(uint16_t(std::min(limit_16bit, b+w)));
-                                    
-                                    write_buf(0, g);
-                                    write_buf(1, r);
-                                    write_buf(2, b);
-                                }
-                                return;
-                            }
-                            if (output_type == HD108_RGB) {
-                                uint8_t *buf = reinterpret_cast<uint8_t *>(&comp_buf[input_pad * uniN]);
-                                for (size_t c = 0, n = 0; c < pixel_loop_n; c += 8, n += 3) {
-                                    auto read_buf = [=] (const size_t i) { return uint32_t(__builtin_bswap16(*reinterpret_cast<const uint16_t *>(&data[c+i*2]))); };
-                                    auto write_buf = [=] (const size_t i, const uint16_t p) { *reinterpret_cast<uint16_t *>(&buf[(n+i)*2]) = __builtin_bswap16(uint16_t(p)); };
-
-                                    uint32_t r = read_buf(0);
-                                    uint32_t g = read_buf(1);
-                                    uint32_t b = read_buf(2);
-                                    uint32_t w = read_buf(3);
-
-                                    r = uint16_t(std::min(limit_16bit, r+w));
-                                    g = uint16_t(std::min(limit_16bit, g+w));
-                                    b = uint16_t(std::min(limit_16bit, b+w));
-                                    
-                                    write_buf(0, r);
-                                    write_buf(1, g);
-                                    write_buf(2, b);
-                                }
-                                return;
-                            }
-                        } break;
-                    }
+                default: {
                 } break;
             }
-        };
-        
-        switch(output_type) {
-            default:
-            case SK9822_RGB:
-            case HDS107S_RGB:
-            case P9813_RGB:
-            case WS2812_RGB:
-            case WS2816_RGB:
-            case SK6812_RGB:
-            case TM1804_RGB:
-            case GS8208_RGB:
-            case UCS1904_RGB: {
-                const std::vector<int> order = { 1, 0, 2 };
-                transfer(order);
-            } break;
-            case APA107_RGB:
-            case APA102_RGB: 
-            case TM1829_RGB: {
-                const std::vector<int> order = { 2, 1, 0 };
-                transfer(order);
-            } break;
-            case HD108_RGB:
-            case TLS3001_RGB: {
-                const std::vector<int> order = { 0, 1, 2 };
-                transfer(order);
-            } break;
-            case SK6812_RGBW: {
-                const std::vector<int> order = { 1, 0, 2, 3 };
-                transfer(order);
-            } break;
-            case LPD8806_RGB: {
-                const std::vector<int> order = { 2, 0, 1 };
-                transfer(order);
-            } break;
-            case WS2801_RGB: {
-                const std::vector<int> order = { 1, 0, 2 };
-                transfer(order);
-            } break;
-        }
-    }
-
-    void Strip::transfer() {
-        PerfMeasure perf(PerfMeasure::SLOT_STRIP_TRANFER);
-        size_t len = 0;
-        if (Model::instance().burstMode() &&
-            output_type != TLS3001_RGB) {
-            const uint8_t *buf = prepareHead(len);
-            if (dmaTransferFunc) {
-                dmaTransferFunc((uint8_t *)(buf), uint16_t(len));
+#ifdef STRIP_DITHER
+            if constexpr (native8 && !dither) {
+                memset(fdst, 0, out_size);
             }
-            prepareTail();
-        } else {
-            const uint8_t *buf = prepare(len);
-            if (dmaTransferFunc) {
-                dmaTransferFunc((uint8_t *)(buf), uint16_t(len));
+#endif  // #ifdef STRIP_DITHER
+            // Grouped pixels repeat the converted value
+            const uint32_t drive = steps(dst);
+            sum += drive;
+            const size_t reps = std::min(group - phase, count - c);
+            for (size_t r = 1; r < reps; r++) {
+                sum += drive - steps(dst + ptrdiff_t(r) * dst_step);
+                memcpy(dst + ptrdiff_t(r) * dst_step, dst, out_size);
+#ifdef STRIP_DITHER
+                if constexpr (native8) {
+                    memcpy(fdst + ptrdiff_t(r) * dst_step, fdst, out_size);
+                }
+#endif  // #ifdef STRIP_DITHER
             }
+            dst += ptrdiff_t(reps) * dst_step;
+#ifdef STRIP_DITHER
+            fdst += ptrdiff_t(reps) * dst_step;
+#endif  // #ifdef STRIP_DITHER
+            c += reps;
+            phase = 0;
         }
+        comp_sum = sum;
     }
 
-    const uint8_t *Strip::prepareHead(size_t &len) {
-        switch(output_type) {
-            case TLS3001_RGB: {
-                return 0;
-            } break;
-            default:
-            case SK6812_RGB:
-            case SK6812_RGBW:
-            case WS2812_RGB:
-            case WS2816_RGB:
-            case TM1804_RGB:
-            case UCS1904_RGB:
-            case TM1829_RGB:
-            case GS8208_RGB: {
-                len = std::min(spi_buf.size(), (bytes_len + bytesLatchLen) * 4);
-                ws2812_alike_convert(0, std::min(bytes_len + bytesLatchLen, size_t(burstHeadLen)));
-                return spi_buf.data();
-            } break;
-            case LPD8806_RGB: {
-                len = std::min(spi_buf.size(), (bytes_len + 1));
-                lpd8806_rgb_alike_convert(0, std::min(bytes_len + 1, size_t(burstHeadLen)));
-                return spi_buf.data();
-            } break;
-            case WS2801_RGB: {
-                len = std::min(spi_buf.size(), bytes_len);
-                ws2801_rgb_alike_convert(0, std::min(bytes_len, size_t(burstHeadLen)));
-                return spi_buf.data();
-            } break;
-            case HD108_RGB:
-            case SK9822_RGB:
-            case HDS107S_RGB:
-            case P9813_RGB:
-            case APA107_RGB:
-            case APA102_RGB: {
-                size_t out_len = bytes_len + bytes_len / 3;
-                size_t ext_len = 32 + ( ( bytes_len / 2 ) + 7 ) / 8;
-                len = std::min(spi_buf.size(), (out_len + ext_len));
-                apa102_rgb_alike_convert(0, std::min(out_len + ext_len, size_t(burstHeadLen)));
-                return spi_buf.data();
-            } break;
+    template<size_t... N>
+    constexpr std::array<Strip::CopyKernel, sizeof...(N)> Strip::makeCopyKernels(std::index_sequence<N...>) {
+        return {{ &Strip::copyKernel<InputType(N / OUTPUT_TYPE_COUNT), outputLayout(OutputType(N % OUTPUT_TYPE_COUNT))>... }};
+    }
+
+    const std::array<Strip::CopyKernel, Strip::INPUT_TYPE_COUNT * Strip::OUTPUT_TYPE_COUNT> Strip::copy_kernels = 
+        Strip::makeCopyKernels(std::make_index_sequence<Strip::INPUT_TYPE_COUNT * Strip::OUTPUT_TYPE_COUNT>());
+
+    void Strip::setUniverseData(const size_t uniN, const uint8_t *data, const size_t len, const InputType type) {
+        copyUniverse(uniN, data, len, type, type == input_type);
+    }
+
+    __attribute__ ((hot, optimize("O3"))) RAMFUNC
+    void Strip::copyUniverse(const size_t uniN, const uint8_t *data, const size_t len, const InputType type, const bool mapped) {
+
+        PerfMeasure perf(PerfMeasure::SLOT_STRIP_COPY);
+
+        if (uniN >= lightkraken::Model::universeN || type >= INPUT_TYPE_COUNT) {
+            return;
         }
+
+        __assume(uniN < Model::universeN);
+        __assume(type < INPUT_TYPE_COUNT);
+
+#ifdef STRIP_INTERPOLATION
+        if (interp_snapshot) {
+            // First universe of a new frame, the blend starts from the old one
+            interp_snapshot = false;
+            memcpy(interp_buf.data(), comp_buf.data(), bytes_len);
+        }
+#endif  // #ifdef STRIP_INTERPOLATION
+
+        const size_t input_size = input_pixel_bytes[type];
+
+        // Physical pixel bounds touched by this universe
+        size_t lo = pixel_len;
+        size_t hi = 0;
+        if (!mapped) {
+            const size_t pixpad = size_t(dmxMaxLen / input_size);
+            copyPixels(data, uniN * pixpad, std::min(len / input_size, pixpad), type, lo, hi);
+        } else {
+            const size_t skip = channel_skip[uniN];
+            if (len < skip) {
+                return;
+            }
+            const size_t first = channel_first[uniN];
+            if (channel_continuous && uniN > 0 && skip) {
+                // Rest of the pixel which started in the previous universe
+                uint8_t *split = channel_split[uniN - 1].data();
+                memcpy(split + input_size - skip, data, skip);
+                copyPixels(split, first - 1, 1, type, lo, hi);
+            }
+            const size_t count = (len - skip) / input_size;
+            copyPixels(data + skip, first, count, type, lo, hi);
+            const size_t tail = (len - skip) - count * input_size;
+            if (channel_continuous && tail && len == dmxMaxLen && uniN + 1 < Model::universeN) {
+                uint8_t *split = channel_split[uniN].data();
+                memcpy(split, data + skip + count * input_size, tail);
+                copyPixels(split, first + count, 1, type, lo, hi);
+            }
+        }
+
+        if (lo < hi) {
+            content_dirty = true;
+        }
+
+#ifndef STRIP_STREAMING
+        const size_t pixsize = getBytesPerPixel();
+        encodeUniverse(uniN, lo * pixsize, hi * pixsize);
+#endif  // #ifndef STRIP_STREAMING
     }
 
-    void Strip::prepareTail() {
-        switch(output_type) {
-            case TLS3001_RGB: {
-            } break;
+    // Copies count input pixels starting at input pixel first through the
+    // grouping and pixel map and widens [lo, hi) to the physical pixels
+    // written.
+    __attribute__ ((hot, optimize("O3"))) RAMFUNC
+    void Strip::copyPixels(const uint8_t *src, size_t first, size_t count, InputType type, size_t &lo, size_t &hi) {
+        if (first >= group_len) {
+            return;
+        }
+        count = std::min(count, group_len - first);
+        const size_t input_size = input_pixel_bytes[type];
+        const size_t group = pixel_group;
+        const size_t start = first * group;
+        const size_t end = std::min((first + count) * group, map_len);
+
+        // Startup patterns and colors come in as a different input type than
+        // the configured one and fall back to a table lookup.
+        CopyKernel kernel = copy_kernel;
+        if (type != input_type) {
+            kernel = copy_kernels[size_t(type) * OUTPUT_TYPE_COUNT + size_t(output_type)];
+        }
+
+        for (size_t c = 0; c < pixel_run_count; c++) {
+            const PixelRun &run = pixel_runs[c];
+            const size_t run_end = size_t(run.logical) + run.len;
+            if (run_end <= start) {
+                continue;
+            }
+            if (run.logical >= end) {
+                break;
+            }
+            const size_t s = std::max(size_t(run.logical), start);
+            const size_t n = std::min(run_end, end) - s;
+            const size_t p0 = size_t(int32_t(run.physical) + int32_t(s - run.logical) * run.step);
+            const size_t p1 = size_t(int32_t(p0) + int32_t(n - 1) * run.step);
+            (this->*kernel)(src + (s / group - first) * input_size, p0, n, run.step, group, s % group);
+            lo = std::min(lo, std::min(p0, p1));
+            hi = std::max(hi, std::max(p0, p1) + 1);
+        }
+    }
+
+    // Called before a universe of a frame is copied. Seeing the same universe
+    // twice means the sender moved on to the next frame while one of ours
+    // got lost, so what we have is sent out first.
+    void Strip::frameUniverse(size_t uniN) {
+        const uint32_t bit = 1UL << uniN;
+        if (frame_received & bit) {
+            transferFrame();
+        }
+        if (frame_received == 0) {
+            frame_time = Systick::instance().systemTime();
+        }
+        frame_received |= bit;
+    }
+
+    bool Strip::frameComplete() const {
+        if (Model::instance().frameTimeout() == 0) {
+            return true;
+        }
+        return (frame_received & universe_mask) == universe_mask;
+    }
+
+    bool Strip::frameTimedOut() const {
+        return frame_received &&
+               (Systick::instance().systemTime() - frame_time) > Model::instance().frameTimeout();
+    }
+
+    void Strip::transferFrame() {
+        clearFrame();
+        transfer();
+    }
+
+    void Strip::transfer() {
+        PerfMeasure perf(PerfMeasure::SLOT_STRIP_TRANFER);
+        if (prepareTransfer(true)) {
+            commitTransfer();
+        }
+    }
+
+    // Strips which got no new data, or the same data again, are only sent
+    // once per refresh interval. An interval of 0 sends every time.
+    bool Strip::contentChanged(uint32_t &hash) {
+        const uint32_t interval = Model::instance().refreshInterval();
+        const bool due = interval == 0 || (Systick::instance().systemTime() - content_time) >= interval;
+        if (!content_dirty) {
+            return due;
+        }
+        if (Model::instance().contentHash()) {
+            hash = contentHash();
+            if (content_valid && hash == content_hash) {
+                content_dirty = false;
+                return due;
+            }
+        }
+        return true;
+    }
+
+    // FNV-1a over words; the component buffer is zero past bytes_len.
+    __attribute__ ((hot, optimize("O3")))
+    uint32_t Strip::contentHash() const {
+        const uint32_t *words = reinterpret_cast<const uint32_t *>(comp_buf.data());
+        const size_t count = (bytes_len + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+        uint32_t hash = 0x811C9DC5;
+        for (size_t c = 0; c < count; c++) {
+            hash = (hash ^ words[c]) * 0x01000193;
+        }
+        return hash;
+    }
+
+    // First half of a transfer: everything up to starting the DMA. Returns
+    // false if there is nothing to send or the transfer had to be deferred.
+    // Without burst the wire buffer is fully encoded on return, so that
+    // commitTransfer() is short enough to start several outputs back to back.
+    bool Strip::prepareTransfer(bool burst) {
+        transfer_prepared = false;
+        if (!transfer_retry) {
+            frames_in++;
+            if (frame_held) {
+                // Replaces the frame we were holding
+                frames_dropped++;
+            }
+        }
+        transfer_retry = false;
+        if (!spi) {
+            return false;
+        }
+        if (pace_ticks && (Systick::instance().systemTick() - pace_tick) < pace_ticks) {
+            return holdFrame();
+        }
+        uint32_t hash = content_hash;
+        const bool refresh = refresh_frame;
+        refresh_frame = false;
+#ifdef STRIP_DITHER
+        if (content_dirty) {
+            updateDither();
+        }
+#endif  // #ifdef STRIP_DITHER
+        if (!contentChanged(hash) && !refresh) {
+            frame_held = false;
+            return false;
+        }
+        const uint8_t *in_flight = spi->inFlight();
+        if (mirror && !in_flight) {
+            // Both outputs start together and run at the same rate
+            in_flight = mirror->inFlight();
+        }
+#ifdef STRIP_STREAMING
+        (void)burst;
+        if (in_flight) {
+            return holdFrame();
+        }
+        updatePowerScale();
+        beginFrame(refresh);
+        if (wire_format == WIRE_TLS3001) {
+            updateTLS3001Frame();
+        }
+        // Prime both halves of the ring, the DMA interrupts take it from there
+        stream_pos = 0;
+        const size_t half = spi_buf.size() / 2;
+        fill(spi_buf.data(), half);
+        fill(spi_buf.data() + half, half);
+#else  // #ifdef STRIP_STREAMING
+        if (wire_format == WIRE_TLS3001) {
+            if (in_flight) {
+                return holdFrame();
+            }
+            updateTLS3001Frame();
+        }
+        size_t index = wire_back;
+        if (wireBuffer(index) == in_flight) {
+            // The back buffer is still on the wire. With double buffering the
+            // front buffer is queued behind it and gets the newer frame instead.
+            const bool queued = wire_double && spi->cancelQueued();
+            if (!queued || (mirror && !mirror->cancelQueued())) {
+                return holdFrame();
+            }
+            frames_dropped++;
+            index ^= 1;
+        }
+        updatePowerScale();
+        uint8_t *buf = wireBuffer(index);
+        if (beginFrame(refresh)) {
+            wire_stale[index] |= wireStaleAll;
+        }
+        // Universes are wire encoded as they arrive, so usually all that is
+        // left to do here is to kick off the DMA. A full encode is only needed
+        // after the strip configuration has changed; in burst mode only the
+        // head is encoded up front and the rest while the DMA is running.
+        transfer_burst = 0;
+        if (burst && (wire_stale[index] & wireStaleAll) && !in_flight && Model::instance().burstMode()) {
+            wire_stale[index] = 0;
+            transfer_burst = std::min(wire_len, burstHeadLen);
+            encodeWire(buf, 0, transfer_burst);
+        } else {
+            refreshWireBuffer(index);
+        }
+        transfer_index = index;
+#endif  // #ifdef STRIP_STREAMING
+        transfer_hash = hash;
+        transfer_refresh = refresh;
+        transfer_prepared = true;
+        return true;
+    }
+
+    // Called once a frame is certain to go out. Returns true if the wire
+    // buffer has to be encoded whole, as what goes out is not what the
+    // universes were encoded with on arrival.
+    bool Strip::beginFrame(bool refresh) {
+        bool whole = false;
+#ifdef STRIP_INTERPOLATION
+        if (interpolating()) {
+            // New frames blend in over the time since the previous one
+            const uint64_t now = Systick::instance().systemTick();
+            if (!refresh) {
+                interp_period = uint32_t(std::min(now - interp_start, uint64_t(SystemCoreClock / interpMinRate)));
+                interp_start = now;
+            }
+            const uint64_t elapsed = now - interp_start;
+            interp_alpha = elapsed >= interp_period ? 256 : uint32_t(elapsed) * 256 / interp_period;
+            interp_running = interp_alpha < 256;
+            whole = true;
+        }
+#endif  // #ifdef STRIP_INTERPOLATION
+#ifdef STRIP_DITHER
+        // Every frame gets the next dither pattern
+        whole = whole || dither_active;
+#endif  // #ifdef STRIP_DITHER
+        (void)refresh;
+        return whole;
+    }
+
+    // Defers the frame to the next Control::update(), frames arriving in the
+    // meantime replace it.
+    bool Strip::holdFrame() {
+        transfer_flag = true;
+        frame_held = true;
+        return false;
+    }
+
+    // Second half of a transfer: start the DMA on what prepareTransfer() left.
+    void Strip::commitTransfer() {
+        if (!transfer_prepared) {
+            return;
+        }
+        transfer_prepared = false;
+        // The bit rate belongs to the buffer, so it follows it onto every
+        // output that sends it, before that output starts
+        uint32_t mirror_psc = 0;
+        const bool mirrored = mirror && mirrorPrescaler(mirror_psc);
+        spi->setPrescaler(wire_psc);
+        if (mirrored) {
+            mirror->setPrescaler(mirror_psc);
+        }
+#ifdef STRIP_STREAMING
+        spi->stream(spi_buf.data(), spi_buf.size(), needsClock(), this);
+#else  // #ifdef STRIP_STREAMING
+        uint8_t *buf = wireBuffer(transfer_index);
+        spi->transfer(buf, wire_len, needsClock());
+        if (mirrored) {
+            mirror->transfer(buf, wire_len, needsClock());
+        }
+        if (transfer_burst) {
+            encodeWire(buf + transfer_burst, transfer_burst, wire_len);
+        }
+        if (wire_double) {
+            wire_back = transfer_index ^ 1;
+        }
+#endif  // #ifdef STRIP_STREAMING
+        content_hash = transfer_hash;
+        content_valid = Model::instance().contentHash();
+        content_dirty = false;
+        content_time = Systick::instance().systemTime();
+        pace_tick = Systick::instance().systemTick();
+        frame_held = false;
+        frames_out++;
+#ifdef STRIP_DITHER
+        if (dither_active) {
+            dither_frame++;
+        }
+#endif  // #ifdef STRIP_DITHER
+#ifdef STRIP_INTERPOLATION
+        if (!transfer_refresh) {
+            interp_snapshot = true;
+        }
+#endif  // #ifdef STRIP_INTERPOLATION
+    }
+
+    // Sends the strip again whenever the wire is idle and no new frame is on
+    // its way in.
+    void Strip::refresh() {
+        if (!refreshActive() || !spi || content_dirty || frame_received || transfer_flag ||
+            spi->inFlight() || (mirror && mirror->inFlight())) {
+            return;
+        }
+        refresh_frame = true;
+        transfer_retry = true;
+        transfer();
+    }
+
+    bool Strip::refreshActive() const {
+#ifdef STRIP_DITHER
+        if (dither_active) {
+            return true;
+        }
+#endif  // #ifdef STRIP_DITHER
+#ifdef STRIP_INTERPOLATION
+        if (interp_running && interpolating()) {
+            return true;
+        }
+#endif  // #ifdef STRIP_INTERPOLATION
+        return false;
+    }
+
+    // Ignored unless built with STRIP_INTERPOLATION
+    void Strip::setInterpolation(bool state) {
+#ifdef STRIP_INTERPOLATION
+        if (interpolate != state) {
+            interpolate = state;
+            interp_running = false;
+            interp_alpha = 256;
+            wire_stale.fill(wireStaleAll);
+        }
+#else  // #ifdef STRIP_INTERPOLATION
+        (void)state;
+#endif  // #ifdef STRIP_INTERPOLATION
+    }
+
+    void Strip::setFpsLimit(uint32_t fps) {
+        pace_ticks = fps ? SystemCoreClock / fps : 0;
+    }
+
+    // Frames per second the wire can carry at the current length, chipset
+    // and SPI clock.
+    uint32_t Strip::maxRefreshRate() const {
+        if (!spi || !wire_len) {
+            return 0;
+        }
+        const uint32_t bit_rate = spi->busClock() / (2UL << wire_psc);
+        return bit_rate / uint32_t(wire_len * 8);
+    }
+
+    void Strip::updateRates() {
+        const uint32_t now = Systick::instance().systemTime();
+        const uint32_t elapsed = now - rates_time;
+        if (elapsed < 1000) {
+            return;
+        }
+        input_rate = (frames_in - rates_in) * 1000 / elapsed;
+        output_rate = (frames_out - rates_out) * 1000 / elapsed;
+        rates_in = frames_in;
+        rates_out = frames_out;
+        rates_time = now;
+    }
+
+    // Typical drive current of a component at full scale (mA), quiescent
+    // current of a pixel (uA) and supply voltage (mV) of the strips the
+    // chipsets come on. Rather high than low, the estimate has to stay on
+    // the safe side.
+    struct PowerModel {
+        uint16_t comp_ma;
+        uint16_t idle_ua;
+        uint16_t supply_mv;
+    };
+
+    static constexpr PowerModel powerModel(Strip::OutputType output_type) {
+        switch (output_type) {
             default:
-            case SK6812_RGB:
-            case SK6812_RGBW:
-            case WS2812_RGB:
-            case WS2816_RGB:
-            case TM1804_RGB:
-            case UCS1904_RGB:
-            case TM1829_RGB:
-            case GS8208_RGB: {
-                ws2812_alike_convert(std::min(bytes_len + bytesLatchLen, size_t(burstHeadLen)), bytes_len + bytesLatchLen);
-            } break;
-            case LPD8806_RGB: {
-                lpd8806_rgb_alike_convert(std::min(bytes_len + 1, size_t(burstHeadLen)), (bytes_len + 1) - 1);
-            } break;
-            case WS2801_RGB: {
-                ws2801_rgb_alike_convert(std::min(bytes_len, size_t(burstHeadLen)), bytes_len - 1);
-            } break;
-            case HD108_RGB:
-            case SK9822_RGB:
-            case HDS107S_RGB:
-            case P9813_RGB:
-            case APA107_RGB:
-            case APA102_RGB: {
-                size_t out_len = bytes_len + bytes_len / 3;
-                size_t ext_len = 32 + ( ( bytes_len / 2 ) + 7 ) / 8;
-                apa102_rgb_alike_convert(std::min(out_len + ext_len, size_t(burstHeadLen)), (out_len + ext_len) - 1);
-            } break;
+            case Strip::WS2812_RGB:
+            case Strip::SK6812_RGB:
+            case Strip::SK6812_RGBW:
+            case Strip::APA102_RGB:
+            case Strip::APA107_RGB:
+            case Strip::SK9822_RGB:
+            case Strip::HDS107S_RGB:
+            case Strip::P9813_RGB:
+            case Strip::HD108_RGB:   return { 20, 1000,  5000 };
+            case Strip::LPD8806_RGB:
+            case Strip::WS2801_RGB:  return { 20,  500,  5000 };
+            case Strip::WS2816_RGB:  return { 16, 1000, 12000 };
+            case Strip::GS8208_RGB:  return { 13, 1000, 12000 };
+            case Strip::TM1804_RGB:
+            case Strip::UCS1904_RGB:
+            case Strip::TM1829_RGB:
+            case Strip::TLS3001_RGB: return { 18, 1000, 12000 };
+        }
+    }
+
+    // Rebuilds comp_sum after comp_buf changed under the copy kernels
+    void Strip::updateCompSum() {
+        const size_t pixsize = getBytesPerPixel();
+        const NativeType native = nativeType();
+        uint32_t sum = 0;
+        for (size_t c = 0; c < pixel_len * pixsize; c += pixsize) {
+            const uint8_t *p = &comp_buf[c];
+            if (native == NATIVE_RGB16) {
+                sum += uint32_t(p[0]) + uint32_t(p[2]) + uint32_t(p[4]);
+                continue;
+            }
+            for (size_t d = 0; d < pixsize; d++) {
+                sum += std::min(limit_8bit, uint32_t(p[d]));
+            }
+        }
+        comp_sum = sum;
+    }
+
+    // Estimated draw in mW of the components and of the pixels at rest,
+    // unscaled and over all outputs the strip is sent to.
+    void Strip::powerDraw(uint32_t &drive, uint32_t &idle) const {
+        const PowerModel model = powerModel(output_type);
+        // Global brightness of APA102 style chipsets, out of 31
+        uint32_t glob = 31;
+        if (wire_format == WIRE_APA102) {
+            glob = illum8 & 0x1F;
+        } else if (wire_format == WIRE_HD108) {
+            glob = illum16 & 0x1F;
+        }
+        drive = uint32_t((uint64_t(comp_sum) * model.comp_ma * model.supply_mv * glob) / (255ULL * 1000ULL * 31ULL)) * power_outputs;
+        idle = uint32_t((uint64_t(pixel_len) * model.idle_ua * model.supply_mv) / 1000000ULL) * power_outputs;
+    }
+
+    uint32_t Strip::estimatedPower() const {
+        uint32_t drive = 0;
+        uint32_t idle = 0;
+        powerDraw(drive, idle);
+        return idle + uint32_t((uint64_t(drive) * power_scale) / powerScaleOne);
+    }
+
+    // All strips get the same scale, so that what the budget leaves after
+    // the pixels at rest is shared out by how much each one asks for. It
+    // goes down right away but back up only in steps, each change means a
+    // LUT rebuild and a full encode.
+    void Strip::updatePowerScale() {
+        uint32_t scale = powerScaleOne;
+        if (power_budget) {
+            uint32_t drive = 0;
+            uint32_t idle = 0;
+            for (size_t c = 0; c < Model::stripN; c++) {
+                uint32_t d = 0;
+                uint32_t i = 0;
+                get(c).powerDraw(d, i);
+                drive += d;
+                idle += i;
+            }
+            const uint32_t left = power_budget > idle ? power_budget - idle : 0;
+            if (drive > left) {
+                scale = uint32_t((uint64_t(left) * powerScaleOne) / drive);
+            }
+        }
+        if (scale == power_scale ||
+            (scale > power_scale && scale < powerScaleOne && scale < power_scale + powerScaleStep)) {
+            return;
+        }
+        power_scale = scale;
+        if (wire_format == WIRE_WS2812) {
+            updateWireLut();
+        }
+        wire_stale.fill(wireStaleAll);
+    }
+
+    // Clockless chipset timing in ns (reset in us) as given by the datasheets.
+    // Low times only have a lower bound, anything well below the reset time
+    // is fine.
+    struct ClocklessTiming {
+        uint16_t t0h_min;
+        uint16_t t0h_max;
+        uint16_t t1h_min;
+        uint16_t t1h_max;
+        uint16_t tl_min;
+        uint16_t reset_us;
+    };
+
+    static constexpr ClocklessTiming clocklessTiming(Strip::OutputType output_type) {
+        switch (output_type) {
+            default:
+            case Strip::WS2812_RGB:  return { 220, 420, 580, 1000, 220, 280 };
+            case Strip::SK6812_RGB:
+            case Strip::SK6812_RGBW: return { 150, 450, 450,  750, 450,  80 };
+            case Strip::GS8208_RGB:  return { 200, 450, 550, 1000, 300, 280 };
+            case Strip::TM1804_RGB:  return { 200, 500, 550, 1000, 450,  50 };
+            case Strip::UCS1904_RGB: return { 200, 450, 550, 1000, 450,  50 };
+            case Strip::TM1829_RGB:  return { 200, 450, 550, 1000, 450, 140 };
+            case Strip::WS2816_RGB:  return { 220, 380, 580, 1000, 450, 280 };
+        }
+    }
+
+    // A data bit is sent as 'bits' SPI bits, the first k0 (zero) or k1 (one)
+    // of them high.
+    static constexpr bool clocklessFits(const ClocklessTiming &t, uint32_t bit_ns, uint32_t bits, uint32_t k0, uint32_t k1) {
+        return k0 * bit_ns >= t.t0h_min && k0 * bit_ns <= t.t0h_max &&
+               k1 * bit_ns >= t.t1h_min && k1 * bit_ns <= t.t1h_max &&
+               (bits - k1) * bit_ns >= t.tl_min;
+    }
+
+    // The classic 4 bit encoding at 3.375MHz has to stay valid for every
+    // chipset, it is what we fall back to.
+    static constexpr bool clocklessFallbackFits() {
+        for (size_t c = 0; c < Strip::OUTPUT_TYPE_COUNT; c++) {
+            switch (Strip::OutputType(c)) {
+                case Strip::WS2812_RGB:
+                case Strip::SK6812_RGB:
+                case Strip::SK6812_RGBW:
+                case Strip::GS8208_RGB:
+                case Strip::TM1804_RGB:
+                case Strip::UCS1904_RGB:
+                case Strip::TM1829_RGB:
+                case Strip::WS2816_RGB: {
+                    if (!clocklessFits(clocklessTiming(Strip::OutputType(c)), 296, 4, 1, 2)) {
+                        return false;
+                    }
+                } break;
+                default: {
+                } break;
+            }
+        }
+        return true;
+    }
+    static_assert(clocklessFallbackFits(), "Fallback clockless encoding violates chipset timing");
+
+    static constexpr uint32_t clocklessFallbackRate = 3375000;
+    static constexpr uint32_t clockedRate = 1687500;
+    // Zero bytes after the frame so reconfiguring the SPI right after the DMA
+    // has finished never cuts into the last symbol
+    static constexpr size_t clocklessTailLen = 4;
+
+    // Slowest prescaler which still runs the SPI at or above rate
+    uint32_t Strip::prescalerForRate(uint32_t rate) const {
+        const uint32_t bus_clock = spi ? spi->busClock() : 108000000;
+        for (uint32_t shift = 7; shift > 0; shift--) {
+            if ((bus_clock / (2UL << shift)) >= rate) {
+                return shift;
+            }
+        }
+        return 0;
+    }
+
+    // The mirror sends the same wire buffer from another bus clock, so it
+    // needs its own prescaler for exactly the same bit rate
+    bool Strip::mirrorPrescaler(uint32_t &shift) const {
+        if (!spi || !mirror) {
+            return false;
+        }
+        for (uint32_t s = 0; s < 8; s++) {
+            if (uint64_t(mirror->busClock()) * (2UL << wire_psc) == uint64_t(spi->busClock()) * (2UL << s)) {
+                shift = s;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Picks the SPI prescaler and symbol length for the chipset: the fewest
+    // SPI bits per data bit first, then the fastest clock satisfying the
+    // timing model. The latch is sized to the chipset reset time.
+    void Strip::updateClocklessEncoding() {
+        const ClocklessTiming timing = clocklessTiming(output_type);
+        const uint32_t bus_clock = spi ? spi->busClock() : 0;
+
+        uint32_t bits = 4;
+        uint32_t k0 = 1;
+        uint32_t k1 = 2;
+        uint32_t shift = prescalerForRate(clocklessFallbackRate);
+        uint32_t bit_ns = bus_clock ? uint32_t((uint64_t(2UL << shift) * 1000000000ULL) / bus_clock) : 296;
+        size_t latch = std::min((size_t(timing.reset_us) * 1000 + bit_ns * 8 - 1) / (bit_ns * 8),
+                                bytesLatchLen * sizeof(uint32_t));
+
+        bool found = false;
+        for (uint32_t n = 3; n <= 5 && bus_clock && !found; n++) {
+            for (uint32_t s = 0; s < 8 && !found; s++) {
+                const uint32_t ns = uint32_t((uint64_t(2UL << s) * 1000000000ULL) / bus_clock);
+                const size_t ns_latch = (size_t(timing.reset_us) * 1000 + ns * 8 - 1) / (ns * 8);
+                if (ns_latch + bytes_len * n + clocklessTailLen > spiMaxLen) {
+                    continue;
+                }
+                for (uint32_t h0 = 1; h0 < n - 1 && !found; h0++) {
+                    for (uint32_t h1 = h0 + 1; h1 < n && !found; h1++) {
+                        if (clocklessFits(timing, ns, n, h0, h1)) {
+                            found = true;
+                            bits = n;
+                            k0 = h0;
+                            k1 = h1;
+                            shift = s;
+                            latch = ns_latch;
+                        }
+                    }
+                }
+            }
+        }
+
+        wire_psc = shift;
+        wire_unit = bits;
+        wire_head = latch;
+        wire_bits = uint8_t(bits);
+        wire_k0 = uint8_t(k0);
+        wire_k1 = uint8_t(k1);
+        updateWireLut();
+    }
+
+    // The component limit and the power scale of 8-bit chipsets are folded
+    // into the LUT, which is only rebuilt when one of them changes.
+    void Strip::updateWireLut() {
+        const bool wide = nativeType() == NATIVE_RGB16;
+        const uint32_t limit = wide ? 0xFF : limit_8bit;
+        const uint32_t scale = wide ? powerScaleOne : power_scale;
+        const uint32_t bits = wire_bits;
+        const uint32_t k0 = wire_k0;
+        const uint32_t k1 = wire_k1;
+        const uint32_t key = bits | (k0 << 4) | (k1 << 8) | (limit << 12) | (scale << 20);
+        if (wire_lut_key == key) {
+            return;
+        }
+        wire_lut_key = key;
+
+        const uint32_t sym0 = ((1UL << k0) - 1) << (bits - k0);
+        const uint32_t sym1 = ((1UL << k1) - 1) << (bits - k1);
+        for (uint32_t c = 0; c < 256; c++) {
+            const uint32_t l = std::min(c, limit) * scale / powerScaleOne;
+            uint64_t p = 0;
+            for (int32_t b = 7; b >= 0; b--) {
+                p = (p << bits) | (((l >> b) & 1) ? sym1 : sym0);
+            }
+            // First four wire bytes in memory order, the fifth one of the 5 bit
+            // encoding goes into its own table. It only depends on the two
+            // lowest data bits, but of the limited and scaled value.
+            uint32_t v = 0;
+            for (uint32_t i = 0; i < std::min(bits, uint32_t(4)); i++) {
+                v |= uint32_t((p >> (8 * (bits - 1 - i))) & 0xFF) << (8 * i);
+            }
+            wire_lut[c] = v;
+            wire_lut_tail[c] = uint8_t(p & 0xFF);
         }
     }
 
@@ -1207,11 +1455,18 @@ namespace lightkraken {
         }
     }
 
-    const uint8_t *Strip::prepare(size_t &len) {
+    // The wire frame of every protocol but TLS3001 is a fixed run of leading
+    // zero bytes, followed by equally sized units which each encode
+    // wire_unit_comp bytes of comp_buf, followed by trailing zero bytes.
+    void Strip::updateWireLayout() {
         switch(output_type) {
             case TLS3001_RGB: {
-                tls3001_alike_convert(len);
-                return spi_buf.data();
+                wire_format = WIRE_TLS3001;
+                wire_psc = prescalerForRate(clocklessFallbackRate);
+                wire_head = 0;
+                wire_unit = 0;
+                wire_unit_comp = 1;
+                wire_len = 0;
             } break;
             default:
             case SK6812_RGB:
@@ -1222,19 +1477,26 @@ namespace lightkraken {
             case UCS1904_RGB:
             case TM1829_RGB:
             case GS8208_RGB: {
-                len = std::min(spi_buf.size(), (bytes_len + bytesLatchLen) * 4);
-                ws2812_alike_convert(0, bytes_len + bytesLatchLen);
-                return spi_buf.data();
+                wire_format = WIRE_WS2812;
+                updateClocklessEncoding();
+                wire_unit_comp = 1;
+                wire_len = wire_head + bytes_len * wire_unit + clocklessTailLen;
             } break;
             case LPD8806_RGB: {
-                len = std::min(spi_buf.size(), (bytes_len + 3));
-                lpd8806_rgb_alike_convert(0, (bytes_len + 3) - 1);
-                return spi_buf.data();
+                wire_format = WIRE_LPD8806;
+                wire_psc = prescalerForRate(clockedRate);
+                wire_head = 1;
+                wire_unit = 1;
+                wire_unit_comp = 1;
+                wire_len = bytes_len + 3;
             } break;
             case WS2801_RGB: {
-                len = std::min(spi_buf.size(), (bytes_len + 3));
-                ws2801_rgb_alike_convert(0, (bytes_len + 3));
-                return spi_buf.data();
+                wire_format = WIRE_WS2801;
+                wire_psc = prescalerForRate(clockedRate);
+                wire_head = 0;
+                wire_unit = 1;
+                wire_unit_comp = 1;
+                wire_len = bytes_len + 3;
             } break;
             case HD108_RGB:
             case SK9822_RGB:
@@ -1242,162 +1504,578 @@ namespace lightkraken {
             case P9813_RGB:
             case APA107_RGB:
             case APA102_RGB: {
-                size_t out_len = bytes_len + bytes_len / 3;
-                size_t ext_len = 32 + ( ( out_len / 2 ) + 7 ) / 8;
-                len = std::min(spi_buf.size(), (out_len + ext_len));
-                apa102_rgb_alike_convert(0, (out_len + ext_len) - 1);
-                return spi_buf.data();
+                size_t out_len = 0;
+                wire_psc = prescalerForRate(clockedRate);
+                wire_head = 32;
+                if (nativeType() == NATIVE_RGB16) {
+                    wire_format = WIRE_HD108;
+                    wire_unit = 8;
+                    wire_unit_comp = 6;
+                } else {
+                    wire_format = WIRE_APA102;
+                    wire_unit = 4;
+                    wire_unit_comp = 3;
+                }
+                out_len = (bytes_len / wire_unit_comp) * wire_unit;
+                wire_len = wire_head + out_len + ( ( out_len / 2 ) + 7 ) / 8;
             } break;
         }
+        wire_len = std::min(wire_len, spiMaxLen);
+        // Copy kernels leave the limit to the wire LUT where it has been folded
+        // in. RGBW still needs it before the white channel is extracted.
+        copy_limit_8bit = (wire_format == WIRE_WS2812 && nativeType() == NATIVE_RGB8) ? 0xFF : limit_8bit;
+#ifdef STRIP_STREAMING
+        wire_double = false;
+#else  // #ifdef STRIP_STREAMING
+        // Ping-pong between both halves of spi_buf if the frame fits
+        wire_double = wire_format != WIRE_TLS3001 && wire_len <= spi_buf.size() / 2;
+#endif  // #ifdef STRIP_STREAMING
+        wire_back = 0;
+        wire_stale.fill(wireStaleAll);
+        content_valid = false;
+        content_dirty = true;
+        updateCompSum();
     }
 
-    __attribute__ ((hot, flatten, optimize("O3")))
-    void Strip::lpd8806_rgb_alike_convert(size_t start, size_t end) {
-        uint8_t *dst = spi_buf.data() + start;
-        *dst++ = 0x00;
-        switch(nativeType()) {
-            default: {
-            } break;
-            case NATIVE_RGBW8:
-            case NATIVE_RGB8: {
-                for (size_t c = std::max(start, size_t(1)); c <= std::min(end, 1 + bytes_len - 1); c++) {
-                    *dst++ = 0x80 | (comp_buf[c-1] >> 1);
-                }
-            } break;
+    uint8_t *Strip::wireBuffer(size_t index) {
+        return spi_buf.data() + (wire_double ? index * (spi_buf.size() / 2) : 0);
+    }
+
+    // Encodes the universe just written to comp_buf into the back buffer,
+    // unless it is still being sent, and marks it stale in the front buffer.
+    void Strip::encodeUniverse(size_t uniN, size_t start, size_t end) {
+        if (wire_format == WIRE_TLS3001 || start >= end) {
+            return;
+        }
+        if (slot_start[uniN] != start || slot_end[uniN] != end) {
+            slot_start[uniN] = uint16_t(start);
+            slot_end[uniN] = uint16_t(end);
+            wire_stale.fill(wireStaleAll);
+        }
+        const uint32_t bit = 1UL << uniN;
+        if (wire_double) {
+            wire_stale[wire_back ^ 1] |= bit;
+        }
+        // A held frame is likely to be replaced, it is encoded when it goes out
+        uint8_t *buf = wireBuffer(wire_back);
+        if ((wire_stale[wire_back] & wireStaleAll) || spi == 0 || spi->inFlight() == buf || frame_held) {
+            wire_stale[wire_back] |= bit;
+            return;
+        }
+#ifdef STRIP_DITHER
+        if (dither_active) {
+            // Dithered frames are encoded whole when they go out
+            return;
         }
+#endif  // #ifdef STRIP_DITHER
+#ifdef STRIP_INTERPOLATION
+        if (interpolating()) {
+            // So are blended ones
+            return;
+        }
+#endif  // #ifdef STRIP_INTERPOLATION
+        encodeCompRange(buf, start, end);
+        wire_stale[wire_back] &= ~bit;
     }
 
-    __attribute__ ((hot, flatten, optimize("O3")))
-    void Strip::ws2801_rgb_alike_convert(size_t start, size_t end) {
-        uint8_t *dst = spi_buf.data() + start;
-        switch(nativeType()) {
-            default: {
-            } break;
-            case NATIVE_RGBW8:
-            case NATIVE_RGB8: {
-                for (size_t c = start; c <= std::min(end, bytes_len - 1); c++) {
-                    *dst++ = comp_buf[c];
-                }
-            } break;
+    void Strip::refreshWireBuffer(size_t index) {
+        uint8_t *buf = wireBuffer(index);
+        const uint32_t stale = wire_stale[index];
+        wire_stale[index] = 0;
+        if (stale & wireStaleAll) {
+            encodeWire(buf, 0, wire_len);
+            return;
+        }
+        for (size_t c = 0; c < Model::universeN; c++) {
+            if (stale & (1UL << c)) {
+                encodeCompRange(buf, slot_start[c], slot_end[c]);
+            }
         }
     }
 
-    __attribute__ ((hot, flatten, optimize("O3"), optimize("unroll-loops")))
-    void Strip::apa102_rgb_alike_convert(size_t start, size_t end) {
+    void Strip::encodeCompRange(uint8_t *buf, size_t start, size_t end) {
+        const size_t first = start / wire_unit_comp;
+        const size_t last = (end + wire_unit_comp - 1) / wire_unit_comp;
+        const size_t wire_start = wire_head + first * wire_unit;
+        const size_t wire_end = std::min(wire_len, wire_head + last * wire_unit);
+        if (wire_start < wire_end) {
+            encodeWire(buf + wire_start, wire_start, wire_end);
+        }
+    }
 
-        // Align to 4 bytes
-        start &= ~3;
+    // Called from the DMA interrupt with the half of the ring which was just
+    // sent out; fills it with the next part of the frame, zero padded past
+    // its end. The frame is complete once the half holding its end is done.
+    __attribute__ ((hot, optimize("O3")))
+    bool Strip::fill(uint8_t *dst, size_t len) {
+        if (stream_pos >= wire_len + len) {
+            return false;
+        }
+        const size_t end = std::min(stream_pos + len, wire_len);
+        const size_t count = stream_pos < end ? end - stream_pos : 0;
+        if (count) {
+            encodeWire(dst, stream_pos, end);
+        }
+        memset(dst + count, 0, len - count);
+        stream_pos += len;
+        return true;
+    }
 
-        uint8_t *dst = spi_buf.data() + start;
-        size_t out_len = bytes_len + ( bytes_len / 3 );
+#ifdef PARALLEL_OUTPUT
+    // Clockless chipsets only, at a bit rate of at most 800kHz with the high
+    // times centered in their windows.
+    bool Strip::laneTiming(Parallel::Timing &timing) const {
+        if (wire_format != WIRE_WS2812) {
+            return false;
+        }
+        const ClocklessTiming t = clocklessTiming(output_type);
+        timing.t0h_ns = (uint32_t(t.t0h_min) + uint32_t(t.t0h_max)) / 2;
+        timing.t1h_ns = (uint32_t(t.t1h_min) + uint32_t(t.t1h_max)) / 2;
+        timing.bit_ns = std::max(uint32_t(1250), timing.t1h_ns + t.tl_min);
+        timing.reset_us = t.reset_us;
+        return true;
+    }
 
-        // start frame
-        size_t head_len = 32;
-        for (size_t c = start; c <= std::min(end, size_t(head_len - 1)); c++) {
-            *dst++ = 0x00;
+    // Like with the SPI, nothing goes out unless the strip has new data or
+    // the refresh interval is due.
+    size_t Strip::laneBegin() {
+        const uint32_t interval = Model::instance().refreshInterval();
+        const bool due = interval && (Systick::instance().systemTime() - content_time) >= interval;
+        if (wire_format != WIRE_WS2812 || !bytes_len || (!content_dirty && !due)) {
+            return 0;
         }
+        updatePowerScale();
+        content_dirty = false;
+        content_time = Systick::instance().systemTime();
+        frames_out++;
+        return bytes_len;
+    }
 
-        size_t offset = 0;
-        // adjust offset
-        for (size_t c = head_len; c < start; c += 4, offset += 3) { }
-        
-        size_t loop_start = std::max(start, size_t(head_len));
-        size_t loop_end = std::min(end, head_len + out_len - 1);
-        
-        switch(nativeType()) {
-            default: {
+    // Called from the DMA interrupt. Components as the wire LUT would send
+    // them, with the limit and power scale applied.
+    __attribute__ ((hot, optimize("O3")))
+    void Strip::laneComps(uint8_t *dst, size_t pos, size_t len) {
+        const size_t count = pos < bytes_len ? std::min(len, bytes_len - pos) : 0;
+        const uint8_t *src = &comp_buf[pos < bytes_len ? pos : 0];
+        const uint32_t scale = power_scale;
+        if (nativeType() == NATIVE_RGB16) {
+            for (size_t c = 0; c + 1 < count; c += 2) {
+                const uint32_t v = (((uint32_t(src[c]) << 8) | uint32_t(src[c + 1])) * scale) / powerScaleOne;
+                dst[c + 0] = uint8_t(v >> 8);
+                dst[c + 1] = uint8_t(v >> 0);
+            }
+        } else {
+            const uint32_t limit = limit_8bit;
+            for (size_t c = 0; c < count; c++) {
+                dst[c] = uint8_t((std::min(uint32_t(src[c]), limit) * scale) / powerScaleOne);
+            }
+        }
+        memset(dst + count, 0, len - count);
+    }
+#endif  // #ifdef PARALLEL_OUTPUT
+
+    // Writes bytes [start, end) of the wire frame to dst
+    __attribute__ ((hot, optimize("O3"))) RAMFUNC
+    void Strip::encodeWire(uint8_t *dst, size_t start, size_t end) {
+        if (wire_format == WIRE_TLS3001) {
+            encodeTLS3001(dst, start, end);
+            return;
+        }
+
+        const size_t units_start = wire_head;
+        const size_t units_end = wire_head + (bytes_len / wire_unit_comp) * wire_unit;
+
+        if (start < units_start && start < end) {
+            size_t len = std::min(end, units_start) - start;
+            memset(dst, 0, len);
+            dst += len;
+            start += len;
+        }
+
+        if (start < units_end && start < end) {
+            std::array<uint8_t, 8> tmp;
+            size_t stop = std::min(end, units_end);
+            size_t unit = (start - units_start) / wire_unit;
+            size_t offset = (start - units_start) % wire_unit;
+            if (offset) {
+                size_t len = std::min(wire_unit - offset, stop - start);
+                encodeUnits(tmp.data(), unit, 1);
+                memcpy(dst, tmp.data() + offset, len);
+                dst += len;
+                start += len;
+                unit++;
+            }
+            size_t count = (stop - start) / wire_unit;
+            if (count) {
+                encodeUnits(dst, unit, count);
+                dst += count * wire_unit;
+                start += count * wire_unit;
+                unit += count;
+            }
+            if (start < stop) {
+                size_t len = stop - start;
+                encodeUnits(tmp.data(), unit, 1);
+                memcpy(dst, tmp.data(), len);
+                dst += len;
+                start += len;
+            }
+        }
+
+        if (start < end) {
+            memset(dst, 0, end - start);
+        }
+    }
+
+    __attribute__ ((hot, optimize("O3"), optimize("unroll-loops"))) RAMFUNC
+    void Strip::encodeUnits(uint8_t *dst, size_t unit, size_t count) {
+#ifdef STRIP_INTERPOLATION
+        if (interp_alpha < 256 && interpolating()) {
+            interpolateUnits(dst, unit, count);
+            return;
+        }
+#endif  // #ifdef STRIP_INTERPOLATION
+#ifdef STRIP_DITHER
+        if (dither_active) {
+            ditherUnits(dst, unit, count);
+            return;
+        }
+#endif  // #ifdef STRIP_DITHER
+        encodeComps(dst, &comp_buf[unit * wire_unit_comp], count);
+    }
+
+    // Power scaling of everything but 8-bit clockless chipsets, which have it
+    // in the LUT, happens on the way to the wire.
+    __attribute__ ((hot, optimize("O3"))) RAMFUNC
+    void Strip::encodeComps(uint8_t *dst, const uint8_t *src, size_t count) {
+        const bool wide = nativeType() == NATIVE_RGB16;
+        if (power_scale >= powerScaleOne || wire_format == WIRE_TLS3001 || (wire_format == WIRE_WS2812 && !wide)) {
+            packComps(dst, src, count);
+            return;
+        }
+        static constexpr size_t chunkComps = 48;
+        std::array<uint8_t, chunkComps + 2> tmp;
+        const size_t chunk = chunkComps / wire_unit_comp;
+        const uint32_t scale = power_scale;
+        // A clockless range of 16-bit components can start on a low byte,
+        // which needs the high byte in front of it to be scaled.
+        const size_t lead = (wide && ((src - comp_buf.data()) & 1)) ? 1 : 0;
+        while (count) {
+            const size_t n = std::min(chunk, count);
+            const size_t len = n * wire_unit_comp;
+            if (wide) {
+                const uint8_t *p = src - lead;
+                for (size_t c = 0; c < len + lead; c += 2) {
+                    const uint32_t v = (((uint32_t(p[c]) << 8) | uint32_t(p[c + 1])) * scale) / powerScaleOne;
+                    tmp[c + 0] = uint8_t(v >> 8);
+                    tmp[c + 1] = uint8_t(v >> 0);
+                }
+            } else {
+                for (size_t c = 0; c < len; c++) {
+                    tmp[c] = uint8_t((uint32_t(src[c]) * scale) / powerScaleOne);
+                }
+            }
+            packComps(dst, tmp.data() + lead, n);
+            dst += n * wire_unit;
+            src += len;
+            count -= n;
+        }
+    }
+
+    __attribute__ ((hot, optimize("O3"), optimize("unroll-loops"))) RAMFUNC
+    void Strip::packComps(uint8_t *dst, const uint8_t *src, size_t count) {
+        switch(wire_format) {
+            case WIRE_WS2812: {
+                switch (wire_unit) {
+                    case 3: {
+                        // Four components pack into three words
+                        size_t c = 0;
+                        for (; c + 4 <= count; c += 4, dst += 12) {
+                            const uint32_t l0 = wire_lut[src[c + 0]];
+                            const uint32_t l1 = wire_lut[src[c + 1]];
+                            const uint32_t l2 = wire_lut[src[c + 2]];
+                            const uint32_t l3 = wire_lut[src[c + 3]];
+                            const uint32_t v[3] = {
+                                l0 | (l1 << 24),
+                                (l1 >> 8) | (l2 << 16),
+                                (l2 >> 16) | (l3 << 8)
+                            };
+                            memcpy(dst, v, sizeof(v));
+                        }
+                        for (; c < count; c++) {
+                            uint32_t v = wire_lut[src[c]];
+                            memcpy(dst, &v, 3);
+                            dst += 3;
+                        }
+                    } break;
+                    default:
+                    case 4: {
+                        for (size_t c = 0; c < count; c++) {
+                            uint32_t v = wire_lut[src[c]];
+                            memcpy(dst, &v, sizeof(v));
+                            dst += sizeof(v);
+                        }
+                    } break;
+                    case 5: {
+                        for (size_t c = 0; c < count; c++) {
+                            uint32_t v = wire_lut[src[c]];
+                            memcpy(dst, &v, sizeof(v));
+                            dst[4] = wire_lut_tail[src[c]];
+                            dst += 5;
+                        }
+                    } break;
+                }
             } break;
-            case NATIVE_RGB16: {
-                uint8_t illum5 = uint8_t(float(0x1f) * std::clamp(glob_illum, 0.0f, 1.0f));
-                uint16_t illum16 = 0b1000'0000'0000'0000 | (illum5 << 10) | (illum5 << 5) | illum5;
-                for (size_t c = loop_start; c <= loop_end; c += 4, offset += 6) {
-                    *dst++ = illum16 >> 8;
-                    *dst++ = illum16 & 0xFF;
-                    *dst++ = comp_buf[offset+0];
-                    *dst++ = comp_buf[offset+1];
-                    *dst++ = comp_buf[offset+2];
-                    *dst++ = comp_buf[offset+3];
-                    *dst++ = comp_buf[offset+4];
-                    *dst++ = comp_buf[offset+5];
+            case WIRE_LPD8806: {
+                size_t c = 0;
+                for (; c + 4 <= count; c += 4) {
+                    uint32_t v;
+                    memcpy(&v, src + c, sizeof(v));
+                    v = ((v >> 1) & 0x7F7F7F7F) | 0x80808080;
+                    memcpy(dst + c, &v, sizeof(v));
                 }
+                for (; c < count; c++) {
+                    dst[c] = 0x80 | (src[c] >> 1);
+                }
+            } break;
+            case WIRE_WS2801: {
+                memcpy(dst, src, count);
             } break;
-            case NATIVE_RGB8: {
-                uint8_t illum = 0b11100000 | uint8_t(float(0x1f) * std::clamp(glob_illum, 0.0f, 1.0f));
-                for (size_t c = loop_start; c <= loop_end; c += 4, offset += 3) {
-                    *dst++ = illum;
-                    *dst++ = comp_buf[offset+0];
-                    *dst++ = comp_buf[offset+1];
-                    *dst++ = comp_buf[offset+2];
+            case WIRE_APA102: {
+                for (size_t c = 0; c < count; c++, src += 3, dst += 4) {
+                    const uint32_t v = uint32_t(illum8) |
+                                       (uint32_t(src[0]) <<  8) |
+                                       (uint32_t(src[1]) << 16) |
+                                       (uint32_t(src[2]) << 24);
+                    memcpy(dst, &v, sizeof(v));
                 }
             } break;
+            case WIRE_HD108: {
+                const uint32_t head = uint32_t(illum16 >> 8) | (uint32_t(illum16 & 0xFF) << 8);
+                for (size_t c = 0; c < count; c++, src += 6, dst += 8) {
+                    const uint32_t v[2] = {
+                        head | (uint32_t(src[0]) << 16) | (uint32_t(src[1]) << 24),
+                        uint32_t(src[2]) | (uint32_t(src[3]) << 8) | (uint32_t(src[4]) << 16) | (uint32_t(src[5]) << 24)
+                    };
+                    memcpy(dst, v, sizeof(v));
+                }
+            } break;
+            case WIRE_TLS3001: {
+            } break;
         }
-        // latch words
-        for (size_t c = std::max(start, head_len + out_len); c <= end; c++) {
-            *dst++ = 0x00;
-            *dst++ = 0x00;
-            *dst++ = 0x00;
-            *dst++ = 0x00;
+    }
+
+#ifdef STRIP_DITHER
+    static constexpr std::array<uint8_t, 256> make_dither_thresholds() {
+        std::array<uint8_t, 256> table = { 0 };
+        for (size_t c = 0; c < table.size(); c++) {
+            uint8_t r = 0;
+            for (size_t b = 0; b < 8; b++) {
+                r |= uint8_t(((c >> b) & 1) << (7 - b));
+            }
+            table[c] = r;
         }
+        return table;
     }
 
-    __attribute__ ((hot, flatten, optimize("O3"), optimize("unroll-loops")))
-    void Strip::ws2812_alike_convert(const size_t start, const size_t end) {
-        uint32_t *dst = (uint32_t *)(spi_buf.data() + start * 4);
-        size_t head_len = bytesLatchLen / 2;
-        for (size_t c = start; c < std::min(end, size_t(head_len)); c++) {
-            *dst++ = 0x00;
+    // Bit reversed counter: any 256 frames in a row see every threshold
+    // once, and small fractions are spread out evenly in between.
+    static constexpr auto dither_thresholds = make_dither_thresholds();
+
+    // Only runs while some component has a fraction to spread. Going in or
+    // out of dithering changes every wire byte.
+    void Strip::updateDither() {
+        const uint32_t *words = reinterpret_cast<const uint32_t *>(dither_buf.data());
+        const size_t count = (bytes_len + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+        uint32_t any = 0;
+        for (size_t c = 0; c < count; c++) {
+            any |= words[c];
         }
-        
-        switch(nativeType()) {
-            default: {
-            } break;
-            case NATIVE_RGB16:
-            case NATIVE_RGBW8:
-            case NATIVE_RGB8: {
-                const uint8_t *src = &comp_buf[std::max(start, size_t(head_len))-head_len];
-                const int32_t len = int32_t(std::min(end, head_len + bytes_len)) - int32_t(std::max(start, size_t(head_len)));
-                for (int32_t c = 0; c <= len; c++) {
-                    dst[c] = ws2812_lut[src[c]];
-                }
-                dst += len;
-            } break;
+        const bool active = any && wire_format != WIRE_TLS3001 && nativeType() != NATIVE_RGB16;
+        if (active != dither_active) {
+            dither_active = active;
+            wire_stale.fill(wireStaleAll);
+        }
+    }
+
+    // Components are rounded up when their fraction is above this frame's
+    // threshold. Each component starts the threshold sequence at a different
+    // point so neighbours don't flicker in step.
+    __attribute__ ((hot, optimize("O3")))
+    void Strip::ditherUnits(uint8_t *dst, size_t unit, size_t count) {
+        static constexpr size_t chunkComps = 48;
+        std::array<uint8_t, chunkComps> tmp;
+        const size_t chunk = chunkComps / wire_unit_comp;
+        const uint32_t limit = copy_limit_8bit;
+        while (count) {
+            const size_t n = std::min(chunk, count);
+            const size_t comp = unit * wire_unit_comp;
+            const uint8_t *src = &comp_buf[comp];
+            const DitherPixel *frac = &dither_buf[comp];
+            uint32_t phase = uint32_t(dither_frame) + uint32_t(comp) * 97;
+            for (size_t c = 0; c < n * wire_unit_comp; c++, phase += 97) {
+                const uint32_t v = src[c];
+                const bool up = frac[c].fraction > dither_thresholds[phase & 0xFF] && v < limit;
+                tmp[c] = uint8_t(v + (up ? 1 : 0));
+            }
+            encodeComps(dst, tmp.data(), n);
+            dst += n * wire_unit;
+            unit += n;
+            count -= n;
         }
-        for (size_t c = std::max(start, head_len + bytes_len); c <= end; c++) {
-            *dst++ = 0x00;
+    }
+#endif  // #ifdef STRIP_DITHER
+
+#ifdef STRIP_INTERPOLATION
+    bool Strip::interpolating() const {
+        return interpolate && wire_format != WIRE_TLS3001 && nativeType() != NATIVE_RGB16;
+    }
+
+    // Blends from the previous frame to the current one in 8.8 fixed point.
+    __attribute__ ((hot, optimize("O3")))
+    void Strip::interpolateUnits(uint8_t *dst, size_t unit, size_t count) {
+        static constexpr size_t chunkComps = 48;
+        std::array<uint8_t, chunkComps> tmp;
+        const size_t chunk = chunkComps / wire_unit_comp;
+        const int32_t alpha = int32_t(interp_alpha);
+        while (count) {
+            const size_t n = std::min(chunk, count);
+            const size_t comp = unit * wire_unit_comp;
+            const uint8_t *to = &comp_buf[comp];
+            const uint8_t *from = &interp_buf[comp];
+            for (size_t c = 0; c < n * wire_unit_comp; c++) {
+                const int32_t a = from[c];
+                tmp[c] = uint8_t(a + (((int32_t(to[c]) - a) * alpha + 128) >> 8));
+            }
+            encodeComps(dst, tmp.data(), n);
+            dst += n * wire_unit;
+            unit += n;
+            count -= n;
         }
     }
+#endif  // #ifdef STRIP_INTERPOLATION
     
-    __attribute__ ((hot, flatten, optimize("O3"), optimize("unroll-loops")))
-    void Strip::tls3001_alike_convert(size_t &len) {
-        uint8_t *dst = spi_buf.data();
-        uint32_t reset = 0b11111111'11111110'10000000'00000000; // 19 bits
-        uint32_t syncw = 0b11111111'11111110'00100000'00000000; // 30 bits
-        uint32_t start = 0b11111111'11111110'01000000'00000000; // 19 bits
-        manchester_bit_buf buf(dst);
+    // TLS3001 frames are a bit stream which is Manchester coded on the wire,
+    // so wire byte k carries the four stream bits [4k, 4k + 4). The first
+    // frame after power up resets and syncs the strip.
+    void Strip::updateTLS3001Frame() {
+        const uint32_t reset = 0b11111111'11111110'10000000'00000000; // 19 bits
+        const uint32_t syncw = 0b11111111'11111110'00100000'00000000; // 30 bits
+        const uint32_t start = 0b11111111'11111110'01000000'00000000; // 19 bits
         if (!strip_reset) {
             strip_reset = true;
-            buf.push(reset, 19);
-            buf.push(0, 4000);
-            buf.push(syncw, 30);
-            buf.push(0, 12*(bytes_len/3));
+            tls3001_frame = {{
+                { reset, 19, false },
+                { 0, 4000, false },
+                { syncw, 30, false },
+                { 0, uint32_t(12 * (bytes_len / 3)), false }
+            }};
         } else {
-            buf.push(start, 19);
-            switch(nativeType()) {
-                default: {
-                } break;
-                case NATIVE_RGBW8:
-                case NATIVE_RGB8: {
-                    for (size_t c = 0; c < bytes_len; c++) {
-                        uint32_t p = uint32_t(comp_buf[c]);
-                        buf.push((p<<19)|(p<<11), 13);
-                    }
-                } break;
+            tls3001_frame = {{
+                { start, 19, false },
+                { 0, uint32_t(13 * bytes_len), true },
+                { 0, 100, false },
+                { start, 19, false }
+            }};
+        }
+        tls3001_len = 0;
+        for (const TLS3001Segment &seg : tls3001_frame) {
+            tls3001_len += seg.len;
+        }
+        wire_len = (tls3001_len + 3) / 4;
+#ifndef STRIP_STREAMING
+        wire_len = std::min(wire_len, spi_buf.size());
+#endif  // #ifndef STRIP_STREAMING
+        wire_stale.fill(wireStaleAll);
+    }
+
+    // Returns n <= 16 bits of the TLS3001 stream starting at bit pos, MSB first.
+    // Each component is sent as 13 bits.
+    __attribute__ ((hot, optimize("O3")))
+    uint32_t Strip::tls3001Bits(size_t pos, size_t n) const {
+        uint32_t out = 0;
+        size_t seg_start = 0;
+        for (const TLS3001Segment &seg : tls3001_frame) {
+            const size_t seg_end = seg_start + seg.len;
+            while (n && pos < seg_end) {
+                const size_t off = pos - seg_start;
+                size_t take = std::min(n, seg_end - pos);
+                uint32_t chunk = 0;
+                if (seg.comps) {
+                    const size_t bit = off % 13;
+                    take = std::min(take, 13 - bit);
+                    chunk = (uint32_t(comp_buf[off / 13]) >> (13 - bit - take)) & ((1UL << take) - 1);
+                } else if (seg.bits) {
+                    chunk = (seg.bits << off) >> (32 - take);
+                }
+                out = (out << take) | chunk;
+                pos += take;
+                n -= take;
             }
-            buf.push(0, 100);
-            buf.push(start, 19);
+            seg_start = seg_end;
         }
-        buf.flush();
+        return out << n;
+    }
+
+    __attribute__ ((hot, optimize("O3")))
+    void Strip::encodeTLS3001(uint8_t *dst, size_t start, size_t end) {
+        size_t c = start;
+        for (; c + 4 <= end && (c + 4) * 4 <= tls3001_len; c += 4, dst += 4) {
+            const uint32_t bits = tls3001Bits(c * 4, 16);
+            const uint32_t v = __builtin_bswap32((uint32_t(manchester_lut[bits >> 8]) << 16) |
+                                                  uint32_t(manchester_lut[bits & 0xFF]));
+            memcpy(dst, &v, sizeof(v));
+        }
+        // The line stays low after the end of the stream
+        for (; c < end; c++) {
+            const size_t pos = c * 4;
+            const size_t valid = pos < tls3001_len ? std::min(tls3001_len - pos, size_t(4)) : 0;
+            *dst++ = uint8_t(manchester_lut[tls3001Bits(pos, 4)] & (0xFF00 >> (2 * valid)));
+        }
+    }
 
-        len = buf.len();
+#ifdef STRIP_BENCHMARK
+    // Prints the wire encoding cost of every output type for a full length
+    // strip. Uses strip 0, the model has to be applied again afterwards.
+    void Strip::benchmark() {
+        DEBUG_PRINTF(("Strip benchmark, %d bytes of hot code and tables in RAM\n",
+            int(_eramfunc - _sramfunc)));
+        Strip &strip = get(0);
+        for (size_t c = 0; c < strip.comp_buf.size(); c++) {
+            strip.comp_buf[c] = uint8_t(c * 7);
+        }
+        // Copy kernels, fed from the second strip as one long universe
+        const uint8_t *src = get(1).comp_buf.data();
+        strip.setStripType(WS2812_RGB);
+        for (size_t t = 0; t < INPUT_TYPE_COUNT; t++) {
+            const InputType type = InputType(t);
+            strip.setInputType(type);
+            strip.setPixelLen(strip.getMaxPixelLen());
+            const size_t count = std::min(strip.group_len, bytesMaxLen / input_pixel_bytes[type]);
+            size_t lo = strip.pixel_len;
+            size_t hi = 0;
+            const uint64_t start = Systick::instance().systemTick();
+            strip.copyPixels(src, 0, count, type, lo, hi);
+            const uint64_t cycles = Systick::instance().systemTick() - start;
+            DEBUG_PRINTF(("Input type %2d: %4d pixels, %4d.%02d cycles/pixel\n",
+                int(t), int(count),
+                int(cycles / count), int(((cycles * 100) / count) % 100)));
+        }
+        for (size_t t = 0; t < OUTPUT_TYPE_COUNT; t++) {
+            strip.setStripType(OutputType(t));
+            strip.setPixelLen(strip.getMaxPixelLen());
+            if (strip.wire_format == WIRE_TLS3001) {
+                strip.strip_reset = true;
+                strip.updateTLS3001Frame();
+            }
+            const uint64_t start = Systick::instance().systemTick();
+            for (size_t pos = 0; pos < strip.wire_len; pos += strip.spi_buf.size()) {
+                strip.encodeWire(strip.spi_buf.data(), pos, std::min(strip.wire_len, pos + strip.spi_buf.size()));
+            }
+            const uint64_t cycles = Systick::instance().systemTick() - start;
+            DEBUG_PRINTF(("Strip type %2d: %4d pixels, %6d wire bytes, %4d.%02d cycles/pixel\n",
+                int(t), int(strip.pixel_len), int(strip.wire_len),
+                int(cycles / strip.pixel_len), int(((cycles * 100) / strip.pixel_len) % 100)));
+        }
     }
+#endif  // #ifdef STRIP_BENCHMARK
 }
@@ -25,20 +25,29 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <stdint.h>
 #include <string.h>
-#include <functional>
 #include <array>
+#include <utility>
 
+#include "./fixed.h"
 #include "./model.h"
+#include "./spi.h"
+#ifdef PARALLEL_OUTPUT
+#include "./parallel.h"
+#endif  // #ifdef PARALLEL_OUTPUT
 
 namespace lightkraken {
     
-    class Strip {
+    class Strip : private SPI::Source
+#ifdef PARALLEL_OUTPUT
+                , private Parallel::Source
+#endif  // #ifdef PARALLEL_OUTPUT
+    {
     public:
 
+        // Low byte of a 16-bit input component on an 8-bit strip
         struct DitherPixel {
-            uint16_t value;
-            int8_t   error;
-        } __attribute__((packed));
+            uint8_t fraction;
+        };
 
         enum StartupMode {
             STARTUP_MODE_COLOR,
@@ -97,22 +106,31 @@ namespace lightkraken {
         static constexpr size_t bytesMaxLen = (dmxMaxLen*lightkraken::Model::universeN);
         static constexpr size_t bytesLatchLen = 64;
         static constexpr size_t spiMaxLen = (bytesMaxLen*sizeof(uint32_t)+bytesLatchLen*sizeof(uint32_t));
-        static constexpr size_t burstHeadLen = 128;
+        static constexpr size_t burstHeadLen = 512;
+#ifdef STRIP_STREAMING
+        static constexpr size_t spiBufLen = 1024;
+#else  // #ifdef STRIP_STREAMING
+        static constexpr size_t spiBufLen = spiMaxLen;
+#endif  // #ifdef STRIP_STREAMING
 
         static Strip &get(size_t index);
 
         bool needsClock() const;
 
-        void setStripType(OutputType type) { output_type = type; }
+        void setStripType(OutputType type);
+        void setInputType(InputType type);
         void setStartupMode(StartupMode type) { startup_mode = type; }
         void setRGBColorSpace(const RGBColorSpace &colorSpace);
-        void setCompLimit(float value) { comp_limit = value; };
-        void setGlobIllum(float value) { glob_illum = value; };
+        void setCompLimit(uq16 value);
+        void setGlobIllum(uq16 value);
 
         void setPixelLen(size_t len);
+        void setPixelMap(const Model::StripConfig::PixelMap &map);
+        void setStartChannel(size_t channel, bool continuous);
         size_t getPixelLen() const;
         size_t getMaxPixelLen() const;
         size_t getBytesPerPixel() const;
+        static size_t universePixelLen(InputType type);
 
 	    NativeType nativeType() const;
 
@@ -121,47 +139,238 @@ namespace lightkraken {
         bool isUniverseActive(size_t uniN, InputType input_type) const;
 
         void transfer();
-
-        std::function<void (const uint8_t *data, size_t len)> dmaTransferFunc;
-        std::function<bool ()> dmaBusyFunc;
+        bool prepareTransfer(bool burst);
+        void commitTransfer();
+
+        // Frame assembly for senders without ArtSync or sACN sync
+        void frameUniverse(size_t uniN);
+        bool frameComplete() const;
+        bool frameTimedOut() const;
+        void transferFrame();
+        void clearFrame() { frame_received = 0; }
+
+        void setSPI(SPI *output);
+#ifdef PARALLEL_OUTPUT
+        void setParallelLane(size_t lane) { Parallel::instance().setLane(lane, this); }
+#endif  // #ifdef PARALLEL_OUTPUT
+        bool setMirrorSPI(SPI *output);
+
+#ifdef STRIP_BENCHMARK
+        static void benchmark();
+#endif  // #ifdef STRIP_BENCHMARK
 
         void setPendingTransferFlag() { transfer_flag = true; }
-        bool pendingTransferFlag() { if (transfer_flag) { transfer_flag = false; return true; } return false; }
+        bool pendingTransferFlag() { if (transfer_flag) { transfer_flag = false; transfer_retry = true; return true; } return false; }
+
+        // Frame pacing: frames beyond the fps limit or the wire rate are
+        // held and coalesced into the latest one.
+        void setFpsLimit(uint32_t fps);
+        uint32_t maxRefreshRate() const;
+        uint32_t inputRate() const { return input_rate; }
+        uint32_t outputRate() const { return output_rate; }
+        uint32_t droppedFrames() const { return frames_dropped; }
+        void updateRates();
+
+        // Dithering and interpolation change the strip between frames, these
+        // keep sending while the wire is idle.
+        void setInterpolation(bool state);
+        void refresh();
+
+        // Power drawn is estimated from the sum of all components, which the
+        // copy kernels keep up to date. When the strips together would draw
+        // more than the budget (mW, 0 for none) they are scaled down alike.
+        static void setPowerBudget(uint32_t mw) { power_budget = mw; }
+        static uint32_t powerBudget() { return power_budget; }
+        void setPowerOutputs(size_t outputs) { power_outputs = outputs; }
+        uint32_t estimatedPower() const;
+        uint32_t powerScale() const { return power_scale; }
 
     private:
-        bool use32Bit();
-        
+        typedef void (Strip::*CopyKernel)(const uint8_t *src, size_t first, size_t count, int32_t step, size_t group, size_t phase);
+
+        template<InputType I, OutputType O>
+        void copyKernel(const uint8_t *src, size_t first, size_t count, int32_t step, size_t group, size_t phase);
+
+        template<size_t... N>
+        static constexpr std::array<CopyKernel, sizeof...(N)> makeCopyKernels(std::index_sequence<N...>);
+
+        static const std::array<CopyKernel, INPUT_TYPE_COUNT * OUTPUT_TYPE_COUNT> copy_kernels;
+
         void init();
+        void updateCopyKernel();
 
         void setBytesLen(size_t len);
         size_t getMaxBytesLen() const;
-	    size_t getBytesPerInputPixel(InputType input_type) const;
-	    size_t getComponentsPerInputPixel(InputType input_type) const;
-	    size_t getComponentBytes(InputType input_type) const;
 
-        const uint8_t *prepareHead(size_t &len);
-        void prepareTail();
-        const uint8_t *prepare(size_t &len);
+        // Consecutive grouped pixels which land on a straight physical run
+        struct PixelRun {
+            uint16_t logical;
+            uint16_t physical;
+            uint16_t len;
+            int16_t step;
+        };
 
-        void lpd8806_rgb_alike_convert(size_t start, size_t end);
-        void ws2801_rgb_alike_convert(size_t start, size_t end);
-        void apa102_rgb_alike_convert(size_t start, size_t end);
-        void ws2812_alike_convert(const size_t start, const size_t end);
-        void tls3001_alike_convert(size_t &len);
+        static constexpr size_t pixelRunsMax = 48;
+
+        void updatePixelMap();
+        void updateChannelMap();
+        void updateUniverseMask();
+        void copyUniverse(const size_t uniN, const uint8_t *data, const size_t len, const InputType type, const bool mapped);
+        void copyPixels(const uint8_t *src, size_t first, size_t count, InputType type, size_t &lo, size_t &hi);
+
+        enum WireFormat {
+            WIRE_WS2812,
+            WIRE_APA102,
+            WIRE_HD108,
+            WIRE_LPD8806,
+            WIRE_WS2801,
+            WIRE_TLS3001
+        };
+
+        bool holdFrame();
+        bool refreshActive() const;
+        bool beginFrame(bool refresh);
+        bool contentChanged(uint32_t &hash);
+        uint32_t contentHash() const;
+
+        static constexpr uint32_t powerScaleOne = 256;
+        static constexpr uint32_t powerScaleStep = 8;
+
+        void updateCompSum();
+        void powerDraw(uint32_t &drive, uint32_t &idle) const;
+        void updatePowerScale();
+
+        void updateWireLayout();
+        void updateClocklessEncoding();
+        void updateWireLut();
+        uint32_t prescalerForRate(uint32_t rate) const;
+        bool mirrorPrescaler(uint32_t &shift) const;
+        uint8_t *wireBuffer(size_t index);
+        void encodeUniverse(size_t uniN, size_t start, size_t end);
+        void refreshWireBuffer(size_t index);
+        void encodeCompRange(uint8_t *buf, size_t start, size_t end);
+        virtual bool fill(uint8_t *dst, size_t len);
+#ifdef PARALLEL_OUTPUT
+        virtual bool laneTiming(Parallel::Timing &timing) const;
+        virtual size_t laneBegin();
+        virtual void laneComps(uint8_t *dst, size_t pos, size_t len);
+#endif  // #ifdef PARALLEL_OUTPUT
+        void encodeWire(uint8_t *dst, size_t start, size_t end);
+        void encodeUnits(uint8_t *dst, size_t unit, size_t count);
+        void encodeComps(uint8_t *dst, const uint8_t *src, size_t count);
+        void packComps(uint8_t *dst, const uint8_t *src, size_t count);
+#ifdef STRIP_DITHER
+        void updateDither();
+        void ditherUnits(uint8_t *dst, size_t unit, size_t count);
+#endif  // #ifdef STRIP_DITHER
+#ifdef STRIP_INTERPOLATION
+        bool interpolating() const;
+        void interpolateUnits(uint8_t *dst, size_t unit, size_t count);
+#endif  // #ifdef STRIP_INTERPOLATION
+        void updateTLS3001Frame();
+        uint32_t tls3001Bits(size_t pos, size_t n) const;
+        void encodeTLS3001(uint8_t *dst, size_t start, size_t end);
+
+        struct TLS3001Segment {
+            uint32_t bits;
+            uint32_t len;
+            bool comps;
+        };
 
-        bool transfer_flag;
+        SPI *spi = 0;
+        SPI *mirror = 0;
+        bool transfer_flag = false;
+        bool transfer_retry = false;
+        bool transfer_refresh = false;
+        bool refresh_frame = false;
+        bool frame_held = false;
+        uint32_t pace_ticks = 0;
+        uint64_t pace_tick = 0;
+        uint32_t frames_in = 0;
+        uint32_t frames_out = 0;
+        uint32_t frames_dropped = 0;
+        uint32_t rates_in = 0;
+        uint32_t rates_out = 0;
+        uint32_t rates_time = 0;
+        uint32_t input_rate = 0;
+        uint32_t output_rate = 0;
+        uint32_t frame_received = 0;
+        uint32_t universe_mask = 0;
+        bool content_dirty = true;
+        bool content_valid = false;
+        uint32_t content_hash = 0;
+        uint32_t content_time = 0;
+        uint32_t frame_time = 0;
+        bool transfer_prepared = false;
+        uint32_t transfer_hash = 0;
+        size_t transfer_index = 0;
+        size_t transfer_burst = 0;
         bool strip_reset = false;
         StartupMode startup_mode = STARTUP_MODE_COLOR;
         OutputType output_type = WS2812_RGB;
+        InputType input_type = INPUT_dRGB8;
+        CopyKernel copy_kernel = 0;
         size_t bytes_len = 0;
-        float comp_limit = 1.0f;
-        float glob_illum = 1.0f;
-        std::array<uint8_t, bytesMaxLen> comp_buf;
-        std::array<uint8_t, spiMaxLen> spi_buf;
-        static bool ws2812_lut_init;
-        static std::array<uint32_t, 256> ws2812_lut;
-        static bool hd108_lut_init;
-        static std::array<std::array<uint16_t, 256>, 3> hd108_lut;
+        size_t pixel_len = 0;
+        Model::StripConfig::PixelMap pixel_map {};
+        size_t map_len = 0;
+        size_t pixel_group = 1;
+        size_t group_len = 0;
+        size_t pixel_run_count = 0;
+        std::array<PixelRun, pixelRunsMax> pixel_runs {};
+        size_t start_channel = 0;
+        bool channel_continuous = false;
+        std::array<uint16_t, Model::universeN> channel_first {};
+        std::array<uint16_t, Model::universeN> channel_skip {};
+        std::array<std::array<uint8_t, 8>, Model::universeN> channel_split {};
+        uint32_t limit_8bit = 0xFF;
+        uint32_t limit_16bit = 0xFFFF;
+        uint32_t copy_limit_8bit = 0xFF;
+        uint8_t illum8 = 0xFF;
+        uint16_t illum16 = 0xFFFF;
+        uint32_t comp_sum = 0;
+        size_t power_outputs = 1;
+        uint32_t power_scale = powerScaleOne;
+        static uint32_t power_budget;
+        WireFormat wire_format = WIRE_WS2812;
+        size_t wire_head = 0;
+        size_t wire_unit = 1;
+        size_t wire_unit_comp = 1;
+        size_t wire_len = 0;
+        uint32_t wire_psc = 4;
+        uint8_t wire_bits = 0;
+        uint8_t wire_k0 = 0;
+        uint8_t wire_k1 = 0;
+        uint32_t wire_lut_key = 0;
+        std::array<uint32_t, 256> wire_lut;
+        std::array<uint8_t, 256> wire_lut_tail;
+        static constexpr uint32_t wireStaleAll = 1UL << 31;
+        bool wire_double = false;
+        size_t wire_back = 0;
+        std::array<uint32_t, 2> wire_stale = {{ wireStaleAll, wireStaleAll }};
+        std::array<uint16_t, Model::universeN> slot_start {};
+        std::array<uint16_t, Model::universeN> slot_end {};
+        size_t stream_pos = 0;
+        std::array<TLS3001Segment, 4> tls3001_frame {};
+        size_t tls3001_len = 0;
+        alignas(uint32_t) std::array<uint8_t, bytesMaxLen> comp_buf;
+        alignas(uint32_t) std::array<uint8_t, spiBufLen> spi_buf;
+#ifdef STRIP_DITHER
+        bool dither_active = false;
+        uint8_t dither_frame = 0;
+        alignas(uint32_t) std::array<DitherPixel, bytesMaxLen> dither_buf {};
+#endif  // #ifdef STRIP_DITHER
+#ifdef STRIP_INTERPOLATION
+        static constexpr uint32_t interpMinRate = 10;
+        bool interpolate = false;
+        bool interp_snapshot = true;
+        bool interp_running = false;
+        uint32_t interp_alpha = 256;
+        uint32_t interp_period = 0;
+        uint64_t interp_start = 0;
+        std::array<uint8_t, bytesMaxLen> interp_buf {};
+#endif  // #ifdef STRIP_INTERPOLATION
+        static const std::array<std::array<uint16_t, 256>, 3> hd108_lut;
     };
 
 }
@@ -0,0 +1,201 @@
+/*
+Copyright 2019 Tinic Uro
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../strip.h"
+#include "../systick.h"
+#include "../perf.h"
+
+using namespace lightkraken;
+
+extern "C" uint32_t SystemCoreClock;
+uint32_t SystemCoreClock = 108000000;
+
+// Sends the same frame through the SPI wire encoder of Strip 0 and as the
+// parallel lane of Strip 1, then checks the lane bytes against the data
+// bits decoded from the SPI wire, for clockless chipsets of both widths,
+// with and without component limit and power scaling.
+
+namespace lightkraken {
+
+Model &Model::instance() {
+    static Model model;
+    return model;
+}
+
+Systick &Systick::instance() {
+    static Systick systick;
+    return systick;
+}
+
+uint64_t Systick::systemTick() {
+    return 0;
+}
+
+PerfMeasure::PerfMeasure(Slot) {
+}
+
+PerfMeasure::~PerfMeasure() {
+}
+
+// The last buffer handed to an SPI, the wire frame under test
+static std::vector<uint8_t> wire;
+
+void SPI::transfer(const uint8_t *buf, size_t len, bool) {
+    wire.assign(buf, buf + len);
+}
+
+void SPI::stream(uint8_t *, size_t, bool, Source *) {
+}
+
+void SPI::update() {
+}
+
+bool SPI::cancelQueued() {
+    return false;
+}
+
+void SPI::dmaDone() {
+}
+
+void SPI::dmaHalfDone() {
+}
+
+static Parallel::Source *lane = 0;
+
+Parallel &Parallel::instance() {
+    static Parallel parallel;
+    return parallel;
+}
+
+void Parallel::setLane(size_t, Source *source) {
+    lane = source;
+}
+
+}
+
+class HostSPI : public SPI {
+public:
+    virtual bool busy() const { return false; }
+    virtual uint32_t busClock() const { return 108000000; }
+    uint32_t bitNs() const { return uint32_t((uint64_t(2UL << psc) * 1000000000ULL) / busClock()); }
+
+private:
+    virtual void start(const uint8_t *, size_t, bool) {}
+    virtual void stop() {}
+};
+
+// Every data bit starts with a rising edge on the wire, its high time tells
+// a one from a zero.
+static bool decode(const std::vector<uint8_t> &bits, uint32_t bit_ns, uint32_t threshold_ns, std::vector<uint8_t> &out) {
+    std::vector<uint8_t> data;
+    size_t pos = 0;
+    const size_t end = bits.size() * 8;
+    auto at = [&bits] (size_t p) { return (bits[p / 8] >> (7 - p % 8)) & 1; };
+    size_t count = 0;
+    for (;;) {
+        while (pos < end && !at(pos)) {
+            pos++;
+        }
+        if (pos >= end) {
+            break;
+        }
+        size_t high = 0;
+        while (pos < end && at(pos)) {
+            pos++;
+            high++;
+        }
+        if (count % 8 == 0) {
+            data.push_back(0);
+        }
+        data.back() = uint8_t((data.back() << 1) | ((high * bit_ns) > threshold_ns ? 1 : 0));
+        count++;
+    }
+    out = data;
+    return count % 8 == 0;
+}
+
+int main() {
+    size_t failures = 0;
+    HostSPI spi;
+
+    const Strip::OutputType types[] = { Strip::WS2812_RGB, Strip::SK6812_RGBW, Strip::WS2816_RGB, Strip::TM1804_RGB };
+    const char *names[] = { "WS2812", "SK6812", "WS2816", "TM1804" };
+    for (size_t t = 0; t < 4; t++) {
+        for (size_t limited = 0; limited < 2; limited++) {
+            for (size_t budget = 0; budget < 2; budget++) {
+                uint8_t data[510];
+                for (auto &d : data) {
+                    d = uint8_t(rand());
+                }
+                Strip::setPowerBudget(budget ? 20000 : 0);
+                for (size_t c = 0; c < Model::stripN; c++) {
+                    Strip &strip = Strip::get(c);
+                    if (c == 0) {
+                        strip.setSPI(&spi);
+                    } else {
+                        strip.setParallelLane(c);
+                    }
+                    strip.setStripType(types[t]);
+                    strip.setInputType(Strip::INPUT_dRGB8);
+                    strip.setPixelLen(100);
+                    strip.setCompLimit(uq16::fromFloat(limited ? 0.7f : 1.0f));
+                    strip.setPowerOutputs(1);
+                    strip.setUniverseData(0, data, sizeof(data), Strip::INPUT_dRGB8);
+                }
+
+                Parallel::Timing timing {};
+                if (!lane || !lane->laneTiming(timing)) {
+                    failures++;
+                    printf("%s: no lane timing\n", names[t]);
+                    continue;
+                }
+                const size_t len = lane->laneBegin();
+                std::vector<uint8_t> comps(len + 48);
+                lane->laneComps(comps.data(), 0, comps.size());
+
+                wire.clear();
+                Strip::get(0).transfer();
+                std::vector<uint8_t> sent;
+                if (!decode(wire, spi.bitNs(), (timing.t0h_ns + timing.t1h_ns) / 2, sent)) {
+                    failures++;
+                    printf("%s: wire does not decode\n", names[t]);
+                    continue;
+                }
+                // Bytes past the frame are zero on the lane and not sent on the wire
+                sent.resize(comps.size(), 0);
+                if (len == 0 || sent != comps) {
+                    failures++;
+                    printf("%s limited %u budget %u: lane bytes differ from the SPI wire\n",
+                           names[t], unsigned(limited), unsigned(budget));
+                }
+            }
+        }
+    }
+    printf("%u failures\n", unsigned(failures));
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+/*
+Copyright 2019 Tinic Uro
+
+Permission is hereby granted, free of charge, to any person obtaining a
+copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "../parallel.h"
+
+using lightkraken::Parallel;
+
+// Compares Parallel::transpose8x8 and Parallel::encodeSlots against a bit
+// by bit reference, for the lane count and first pin this is built with.
+
+static size_t failures = 0;
+
+static uint32_t random_state = 0x2545F491;
+
+static uint8_t random8() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return uint8_t(random_state >> 24);
+}
+
+// Bit s of out[t] is bit 7 - t of in[s]
+static void reference_transpose(const uint8_t *in, uint8_t *out) {
+    for (size_t t = 0; t < 8; t++) {
+        out[t] = 0;
+        for (size_t s = 0; s < 8; s++) {
+            if (in[s] & (0x80 >> t)) {
+                out[t] |= uint8_t(1 << s);
+            }
+        }
+    }
+}
+
+// Bit b of every byte goes out MSB first, a lane sending a zero has its pin
+// set in the slot
+static void reference_slots(Parallel::Slot *dst, const uint8_t *const *lanes, size_t len) {
+    for (size_t c = 0; c < len; c++) {
+        for (size_t b = 0; b < 8; b++) {
+            uint32_t slot = 0;
+            for (size_t l = 0; l < Parallel::laneN; l++) {
+                if (!(lanes[l][c] & (0x80 >> b))) {
+                    slot |= 1UL << (Parallel::firstPin + l);
+                }
+            }
+            dst[c * 8 + b] = Parallel::Slot(slot);
+        }
+    }
+}
+
+static void check_transpose(const char *name, const uint8_t *in) {
+    uint8_t out[8];
+    uint8_t ref[8];
+    Parallel::transpose8x8(in, out);
+    reference_transpose(in, ref);
+    if (memcmp(out, ref, sizeof(out)) != 0) {
+        failures++;
+        printf("transpose8x8 %s: %02x %02x %02x %02x %02x %02x %02x %02x\n", name,
+               in[0], in[1], in[2], in[3], in[4], in[5], in[6], in[7]);
+    }
+}
+
+static void check_slots(const char *name, const std::vector<std::vector<uint8_t>> &comps) {
+    const size_t len = comps[0].size();
+    std::array<const uint8_t *, Parallel::laneN> lanes;
+    for (size_t l = 0; l < Parallel::laneN; l++) {
+        lanes[l] = comps[l].data();
+    }
+    std::vector<Parallel::Slot> out(len * 8);
+    std::vector<Parallel::Slot> ref(len * 8);
+    Parallel::encodeSlots(out.data(), lanes.data(), len);
+    reference_slots(ref.data(), lanes.data(), len);
+    for (size_t c = 0; c < len * 8; c++) {
+        if (out[c] != ref[c]) {
+            failures++;
+            printf("encodeSlots %s: slot %u is %04x, expected %04x\n", name,
+                   unsigned(c), unsigned(out[c]), unsigned(ref[c]));
+            return;
+        }
+    }
+}
+
+static void test_transpose() {
+    uint8_t in[8];
+
+    memset(in, 0x00, sizeof(in));
+    check_transpose("all 0", in);
+    memset(in, 0xFF, sizeof(in));
+    check_transpose("all 1", in);
+
+    for (size_t bit = 0; bit < 64; bit++) {
+        memset(in, 0x00, sizeof(in));
+        in[bit / 8] = uint8_t(1 << (bit % 8));
+        check_transpose("single 1", in);
+        memset(in, 0xFF, sizeof(in));
+        in[bit / 8] = uint8_t(~(1 << (bit % 8)));
+        check_transpose("single 0", in);
+    }
+
+    for (size_t c = 0; c < 100000; c++) {
+        for (size_t s = 0; s < 8; s++) {
+            in[s] = random8();
+        }
+        check_transpose("random", in);
+    }
+}
+
+static void test_slots() {
+    const size_t len = 48;
+    std::vector<std::vector<uint8_t>> comps(Parallel::laneN, std::vector<uint8_t>(len));
+
+    for (auto &lane : comps) {
+        std::fill(lane.begin(), lane.end(), 0x00);
+    }
+    check_slots("all 0", comps);
+    for (auto &lane : comps) {
+        std::fill(lane.begin(), lane.end(), 0xFF);
+    }
+    check_slots("all 1", comps);
+
+    // Every bit of every lane on its own, once set and once cleared
+    for (size_t l = 0; l < Parallel::laneN; l++) {
+        for (size_t bit = 0; bit < 8; bit++) {
+            for (auto &lane : comps) {
+                std::fill(lane.begin(), lane.end(), 0x00);
+            }
+            comps[l][len / 2] = uint8_t(1 << bit);
+            check_slots("single 1", comps);
+            for (auto &lane : comps) {
+                std::fill(lane.begin(), lane.end(), 0xFF);
+            }
+            comps[l][len / 2] = uint8_t(~(1 << bit));
+            check_slots("single 0", comps);
+        }
+    }
+
+    for (size_t c = 0; c < 2000; c++) {
+        for (auto &lane : comps) {
+            for (auto &comp : lane) {
+                comp = random8();
+            }
+        }
+        check_slots("random", comps);
+    }
+}
+
+int main() {
+    test_transpose();
+    test_slots();
+    printf("%u lanes from pin %u: %u failures\n",
+           unsigned(Parallel::laneN), unsigned(Parallel::firstPin), unsigned(failures));
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,13 @@
+// Host stand-in for the lwIP header, only what the model needs to compile
+#ifndef LWIP_HDR_IP_ADDR_H
+#define LWIP_HDR_IP_ADDR_H
+
+#include <stdint.h>
+
+typedef struct ip4_addr {
+    uint32_t addr;
+} ip4_addr_t;
+
+typedef ip4_addr_t ip_addr_t;
+
+#endif  // #ifndef LWIP_HDR_IP_ADDR_H
@@ -0,0 +1,7 @@
+// Host stand-in for the lwIP header, only what the model needs to compile
+#ifndef LWIP_HDR_UDP_H
+#define LWIP_HDR_UDP_H
+
+#include "lwip/ip_addr.h"
+
+#endif  // #ifndef LWIP_HDR_UDP_H